@@ -0,0 +1,326 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "srcs/map/map.hpp"
+#include "srcs/map/ranked_map.hpp"
+#include "srcs/map/aggregate_map.hpp"
+#include "srcs/map/persistent_map.hpp"
+#include "srcs/map/concurrent_map.hpp"
+#include "srcs/map/sharded_map.hpp"
+#include "srcs/map/rcu_map.hpp"
+#include "srcs/stack/stack.hpp"
+#include "srcs/stack/concurrent_stack.hpp"
+#include "srcs/vector/vector.hpp"
+#include "srcs/vector/concurrent_vector.hpp"
+#include "srcs/pool_allocator.hpp"
+#include "srcs/parallel.hpp"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <sstream>
+
+void	map_bench(void);
+void	stack_bench(void);
+void	vector_bench(void);
+
+// bench helper functions
+
+// monotonic wall clock in nanoseconds
+inline double	bench_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+// the number of cpus online: the benches shared between threads do not
+// run more threads than that
+inline size_t	bench_threads(void)
+{
+	long	n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return ((n < 1) ? 1 : static_cast<size_t>(n));
+}
+
+// cheap deterministic generator so that ft and std see the same keys
+inline size_t	bench_rand(size_t& state)
+{
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (state >> 17);
+}
+
+template <typename Map>
+void	bench_fill(Map& map, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		map.insert(typename Map::value_type(i * 2, i));
+}
+
+// std::less that counts the comparisons it makes
+extern size_t	g_bench_compares;
+
+template <typename T>
+struct bench_counting_less
+{
+	bool	operator()(const T& x, const T& y) const
+	{
+		g_bench_compares++;
+		return (x < y);
+	}
+};
+
+// borrowed view of the characters of a string, the c++98 stand-in for
+// a string_view: comparisons with it need no strlen and no copy
+struct bench_string_ref
+{
+	bench_string_ref(const char* s) :
+		data(s),
+		size(std::strlen(s))
+		{ }
+
+	const char*	data;
+	size_t		size;
+};
+
+// transparent string comparator, for lookups with borrowed strings
+struct bench_string_less
+{
+	typedef void	is_transparent;
+
+	bool	operator()(const std::string& x, const std::string& y) const
+	{
+		return (x < y);
+	}
+
+	bool	operator()(const std::string& x, const bench_string_ref& y) const
+	{
+		return (_compare(x.data(), x.size(), y.data, y.size) < 0);
+	}
+
+	bool	operator()(const bench_string_ref& x, const std::string& y) const
+	{
+		return (_compare(x.data, x.size, y.data(), y.size()) < 0);
+	}
+
+	static int	_compare(const char* x, size_t x_size, const char* y, size_t y_size)
+	{
+		int	ret = std::memcmp(x, y, (x_size < y_size) ? x_size : y_size);
+
+		if (ret != 0)
+			return (ret);
+		return ((x_size < y_size) ? -1 : (x_size > y_size));
+	}
+};
+
+// std::allocator that keeps a running total of the bytes it hands out,
+// used to report the memory footprint of a container per entry
+extern size_t	g_bench_bytes;
+extern size_t	g_bench_allocs;
+
+template <typename T>
+class bench_counting_allocator : public std::allocator<T>
+{
+	public:
+	typedef typename std::allocator<T>::pointer		pointer;
+	typedef typename std::allocator<T>::size_type	size_type;
+
+	template <typename U>
+	struct rebind {
+		typedef bench_counting_allocator<U>	other;
+	};
+
+	bench_counting_allocator(void) { }
+	bench_counting_allocator(const bench_counting_allocator& from) : std::allocator<T>(from) { }
+	template <typename U>
+	bench_counting_allocator(const bench_counting_allocator<U>& from) : std::allocator<T>(from) { }
+
+	pointer	allocate(size_type n, const void* hint = 0)
+	{
+		g_bench_bytes += n * sizeof(T);
+		g_bench_allocs++;
+		return (std::allocator<T>::allocate(n, hint));
+	}
+
+	void	deallocate(pointer p, size_type n)
+	{
+		g_bench_bytes -= n * sizeof(T);
+		std::allocator<T>::deallocate(p, n);
+	}
+};
+
+inline void	bench_report(const char* name, const char* ns, size_t n, double ns_per_op)
+{
+	std::cout << std::left << std::setw(24) << name
+		<< std::setw(5) << ns
+		<< std::right << std::setw(10) << n
+		<< std::setw(12) << std::fixed << std::setprecision(1) << ns_per_op
+		<< " ns/op" << std::endl;
+}
+
+// ft::map shared the usual way, a mutex around every operation, with
+// the interface of concurrent_map
+struct bench_locked_map
+{
+	bench_locked_map(void)
+	{
+		pthread_mutex_init(&lock, NULL);
+	}
+
+	~bench_locked_map(void)
+	{
+		pthread_mutex_destroy(&lock);
+	}
+
+	bool	find(size_t k, size_t& value)
+	{
+		ft::map<size_t, size_t>::iterator	it;
+		bool								found;
+
+		pthread_mutex_lock(&lock);
+		it = map.find(k);
+		found = (it != map.end());
+		if (found)
+			value = it->second;
+		pthread_mutex_unlock(&lock);
+		return (found);
+	}
+
+	void	insert_or_assign(size_t k, size_t value)
+	{
+		pthread_mutex_lock(&lock);
+		map.insert_or_assign(k, value);
+		pthread_mutex_unlock(&lock);
+	}
+
+	void	erase(size_t k)
+	{
+		pthread_mutex_lock(&lock);
+		map.erase(k);
+		pthread_mutex_unlock(&lock);
+	}
+
+	ft::map<size_t, size_t>	map;
+	pthread_mutex_t			lock;
+};
+
+// ft::stack shared the usual way, a mutex around every operation, with
+// the interface of concurrent_stack
+struct bench_locked_stack
+{
+	bench_locked_stack(void)
+	{
+		pthread_mutex_init(&lock, NULL);
+	}
+
+	~bench_locked_stack(void)
+	{
+		pthread_mutex_destroy(&lock);
+	}
+
+	void	push(size_t value)
+	{
+		pthread_mutex_lock(&lock);
+		stack.push(value);
+		pthread_mutex_unlock(&lock);
+	}
+
+	bool	pop(size_t& value)
+	{
+		return (pop_bulk(&value, 1) == 1);
+	}
+
+	void	push_bulk(const size_t* first, const size_t* last)
+	{
+		pthread_mutex_lock(&lock);
+		for (; first != last; ++first)
+			stack.push(*first);
+		pthread_mutex_unlock(&lock);
+	}
+
+	size_t	pop_bulk(size_t* out, size_t n)
+	{
+		size_t	k = 0;
+
+		pthread_mutex_lock(&lock);
+		for (; k < n && !stack.empty(); k++)
+		{
+			out[k] = stack.top();
+			stack.pop();
+		}
+		pthread_mutex_unlock(&lock);
+		return (k);
+	}
+
+	ft::stack<size_t>	stack;
+	pthread_mutex_t		lock;
+};
+
+// ft::vector shared the usual way, a mutex around every operation, with
+// the interface of concurrent_vector
+struct bench_locked_vector
+{
+	bench_locked_vector(void)
+	{
+		pthread_mutex_init(&lock, NULL);
+	}
+
+	~bench_locked_vector(void)
+	{
+		pthread_mutex_destroy(&lock);
+	}
+
+	size_t	push_back(size_t value)
+	{
+		size_t	i;
+
+		pthread_mutex_lock(&lock);
+		i = vector.size();
+		vector.push_back(value);
+		pthread_mutex_unlock(&lock);
+		return (i);
+	}
+
+	size_t	size(void)
+	{
+		size_t	n;
+
+		pthread_mutex_lock(&lock);
+		n = vector.size();
+		pthread_mutex_unlock(&lock);
+		return (n);
+	}
+
+	// copied out under the lock: a reference would not survive a
+	// reallocation by another thread
+	size_t	operator[](size_t i)
+	{
+		size_t	value;
+
+		pthread_mutex_lock(&lock);
+		value = vector[i];
+		pthread_mutex_unlock(&lock);
+		return (value);
+	}
+
+	void	reserve(size_t n)
+	{
+		pthread_mutex_lock(&lock);
+		vector.reserve(n);
+		pthread_mutex_unlock(&lock);
+	}
+
+	ft::vector<size_t>	vector;
+	pthread_mutex_t		lock;
+};
+
+#endif
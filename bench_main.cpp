@@ -0,0 +1,9 @@
+#include "bench.hpp"
+
+int	main(void)
+{
+	map_bench();
+	stack_bench();
+	vector_bench();
+	return (0);
+}
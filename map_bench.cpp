@@ -0,0 +1,909 @@
+#include "bench.hpp"
+
+// keeps the optimizer from discarding lookups whose result is unused
+static size_t	g_sink;
+
+size_t	g_bench_bytes = 0;
+size_t	g_bench_allocs = 0;
+size_t	g_bench_compares = 0;
+
+static size_t	bench_size(size_t i)
+{
+	return (i);
+}
+
+static std::string	bench_string(size_t i)
+{
+	std::ostringstream	s;
+
+	s << "key-" << i;
+	return (s.str());
+}
+
+// bytes obtained from the allocator per entry
+template <typename Map>
+static void	bench_footprint(const char* name, const char* ns, size_t n,
+	typename Map::key_type (*make)(size_t))
+{
+	size_t	before = g_bench_bytes;
+	Map		map;
+
+	for (size_t i = 0; i < n; i++)
+		map.insert(typename Map::value_type(make(i), make(i)));
+	std::cout << std::left << std::setw(24) << name
+		<< std::setw(5) << ns
+		<< std::right << std::setw(10) << n
+		<< std::setw(12) << std::fixed << std::setprecision(1)
+		<< static_cast<double>(g_bench_bytes - before) / n
+		<< " bytes/entry" << std::endl;
+}
+
+// short lived maps that mostly stay empty: construction, swap and
+// destruction, with the number of allocations they cost
+template <typename Map>
+static void	bench_empty(const char* ns, size_t n)
+{
+	size_t	allocs = g_bench_allocs;
+	double	start = bench_now();
+
+	for (size_t i = 0; i < n; i++)
+	{
+		Map	map;
+		Map	other;
+
+		map.swap(other);
+		g_sink += map.empty();
+	}
+	bench_report("empty map", ns, n, (bench_now() - start) / n);
+	std::cout << std::left << std::setw(24) << "empty map"
+		<< std::setw(5) << ns
+		<< std::right << std::setw(10) << n
+		<< std::setw(12) << std::fixed << std::setprecision(1)
+		<< static_cast<double>(g_bench_allocs - allocs) / n
+		<< " allocs/op" << std::endl;
+}
+
+// find with borrowed keys too long for the small string buffer: unless
+// the comparator is transparent, every probe builds (and frees) a string
+template <typename Map, typename Borrowed>
+static void	bench_borrowed_lookup(const char* name, const char* ns, size_t n, size_t queries)
+{
+	Map							map;
+	std::vector<std::string>	keys;
+	size_t						state = 5;
+	double						start;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		keys.push_back("borrowed-lookup-" + bench_string(i));
+		map.insert(typename Map::value_type(keys.back(), i));
+	}
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+		g_sink += (map.find(Borrowed(keys[bench_rand(state) % n].c_str())) == map.end());
+	bench_report(name, ns, n, (bench_now() - start) / queries);
+}
+
+// lower_bound, upper_bound, equal_range and count on maps of growing size:
+// the cost per query should only grow with log(n)
+template <typename Map>
+static void	bench_bounds(const char* ns, size_t n, size_t queries)
+{
+	Map		map;
+	size_t	state = 42;
+	double	start;
+
+	bench_fill(map, n);
+
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+		g_sink += (map.lower_bound(bench_rand(state) % (2 * n)) == map.end());
+	bench_report("lower_bound", ns, n, (bench_now() - start) / queries);
+
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+		g_sink += (map.upper_bound(bench_rand(state) % (2 * n)) == map.end());
+	bench_report("upper_bound", ns, n, (bench_now() - start) / queries);
+
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+		g_sink += (map.equal_range(bench_rand(state) % (2 * n)).first == map.end());
+	bench_report("equal_range", ns, n, (bench_now() - start) / queries);
+
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+		g_sink += map.count(bench_rand(state) % (2 * n));
+	bench_report("count", ns, n, (bench_now() - start) / queries);
+}
+
+// ingest of already sorted keys, with and without an end() hint
+template <typename Map>
+static void	bench_sorted_ingest(const char* ns, size_t n)
+{
+	double	start;
+
+	{
+		Map	map;
+
+		start = bench_now();
+		for (size_t i = 0; i < n; i++)
+			map.insert(typename Map::value_type(i, i));
+		bench_report("sorted insert", ns, n, (bench_now() - start) / n);
+	}
+	{
+		Map	map;
+
+		start = bench_now();
+		for (size_t i = 0; i < n; i++)
+			map.insert(map.end(), typename Map::value_type(i, i));
+		bench_report("sorted insert(end())", ns, n, (bench_now() - start) / n);
+	}
+}
+
+// construction from a sorted range, as when loading a dump
+template <typename Map, typename Pair>
+static void	bench_sorted_build(const char* ns, size_t n)
+{
+	std::vector<Pair>	dump;
+	double				start;
+
+	for (size_t i = 0; i < n; i++)
+		dump.push_back(Pair(i, i));
+	start = bench_now();
+	{
+		Map	map(dump.begin(), dump.end());
+
+		g_sink += map.size();
+	}
+	bench_report("sorted range build", ns, n, (bench_now() - start) / n);
+}
+
+// inserts in random, ascending and descending order (the last two always
+// land next to begin or to the rightmost node), about a third of them
+// on keys that are already there, with the comparisons made per insert
+template <typename Map>
+static void	bench_insert_cost(const char* ns, size_t n)
+{
+	const char*	names[3] = { "insert random", "insert ascending", "insert descending" };
+	size_t		state = 3;
+	size_t		key;
+	size_t		compares;
+	double		start;
+
+	for (size_t order = 0; order < 3; order++)
+	{
+		Map		map;
+
+		compares = g_bench_compares;
+		start = bench_now();
+		for (size_t i = 0; i < n; i++)
+		{
+			if (order == 0)
+				key = bench_rand(state) % (2 * n);
+			else
+				key = (order == 1) ? (i - i % 3) : (n - i + i % 3);
+			map.insert(typename Map::value_type(key, i));
+		}
+		bench_report(names[order], ns, n, (bench_now() - start) / n);
+		std::cout << std::left << std::setw(24) << names[order]
+			<< std::setw(5) << ns
+			<< std::right << std::setw(10) << n
+			<< std::setw(12) << std::fixed << std::setprecision(1)
+			<< static_cast<double>(g_bench_compares - compares) / n
+			<< " compares/op" << std::endl;
+		g_sink += map.size();
+	}
+}
+
+// churn: random erase + insert pairs on a map of constant size,
+// then repeated fill/clear cycles
+template <typename Map>
+static void	bench_churn(const char* name, const char* ns, size_t n, size_t ops)
+{
+	Map							map;
+	typename Map::iterator		victim;
+	size_t						state = 7;
+	double						start;
+
+	bench_fill(map, n);
+	start = bench_now();
+	for (size_t i = 0; i < ops; i++)
+	{
+		victim = map.lower_bound(bench_rand(state) % (2 * n));
+		if (victim == map.end())
+			victim = map.begin();
+		map.erase(victim);
+		map.insert(typename Map::value_type(bench_rand(state) % (2 * n), i));
+	}
+	bench_report(name, ns, n, (bench_now() - start) / ops);
+	start = bench_now();
+	for (size_t i = 0; i < 10; i++)
+	{
+		map.clear();
+		bench_fill(map, n);
+	}
+	bench_report("fill/clear cycles", ns, n, (bench_now() - start) / (10 * n));
+}
+
+// range erase on a map of n keys filled in order: trimming the oldest
+// half, then windows of 1000 keys out of the middle
+template <typename Map>
+static void	bench_range_erase(const char* ns, size_t n)
+{
+	Map		map;
+	double	start;
+
+	bench_fill(map, n);
+	start = bench_now();
+	map.erase(map.begin(), map.lower_bound(n));
+	bench_report("erase oldest half", ns, n, (bench_now() - start) / (n / 2));
+	start = bench_now();
+	for (size_t i = 0; i < 100; i++)
+	{
+		typename Map::iterator	first = map.lower_bound(n + i * n / 100);
+
+		map.erase(first, map.lower_bound(first->first + 2000));
+	}
+	bench_report("erase 1000 keys windows", ns, n, (bench_now() - start) / 100);
+	g_sink += map.size();
+}
+
+// split at random keys and join back, against std::map rebuilding the
+// upper part from a range and inserting it back
+static void	bench_split_join(size_t n, size_t rounds)
+{
+	ft::map<size_t, size_t>		ft_map;
+	std::map<size_t, size_t>	std_map;
+	size_t						state = 11;
+	size_t						key;
+	double						start;
+
+	bench_fill(ft_map, n);
+	bench_fill(std_map, n);
+	start = bench_now();
+	for (size_t i = 0; i < rounds; i++)
+	{
+		ft::map<size_t, size_t>	upper = ft_map.split(bench_rand(state) % (2 * n));
+
+		ft_map.join(upper);
+	}
+	bench_report("split + join", "ft", n, (bench_now() - start) / rounds);
+	g_sink += ft_map.size();
+	start = bench_now();
+	for (size_t i = 0; i < rounds; i++)
+	{
+		key = bench_rand(state) % (2 * n);
+
+		std::map<size_t, size_t>	upper(std_map.lower_bound(key), std_map.end());
+
+		std_map.erase(std_map.lower_bound(key), std_map.end());
+		std_map.insert(upper.begin(), upper.end());
+	}
+	bench_report("split + join", "std", n, (bench_now() - start) / rounds);
+}
+
+// batches of independent random keys, as a request handler would look
+// up: find_many against a loop of find on the same map
+template <typename Map>
+static void	bench_find_many(size_t n, size_t batch, size_t queries)
+{
+	Map									map;
+	std::vector<size_t>					keys(queries);
+	std::vector<typename Map::iterator>	found(batch);
+	size_t								state = 17;
+	double								start;
+
+	bench_fill(map, n);
+	for (size_t i = 0; i < queries; i++)
+		keys[i] = bench_rand(state) % (2 * n);
+	start = bench_now();
+	for (size_t i = 0; i + batch <= queries; i += batch)
+	{
+		for (size_t j = 0; j < batch; j++)
+			found[j] = map.find(keys[i + j]);
+		g_sink += (found[0] == map.end());
+	}
+	bench_report("find loop", "ft", n, (bench_now() - start) / queries);
+	start = bench_now();
+	for (size_t i = 0; i + batch <= queries; i += batch)
+	{
+		map.find_many(keys.begin() + i, keys.begin() + i + batch, found.begin());
+		g_sink += (found[0] == map.end());
+	}
+	bench_report("find_many", "ft", n, (bench_now() - start) / queries);
+}
+
+// rank queries: nth, rank and distance on a ranked_map against
+// the linear walks a plain map needs for the same answers
+static void	bench_order_statistics(size_t n, size_t queries)
+{
+	ft::ranked_map<size_t, size_t>	ft_map;
+	std::map<size_t, size_t>		std_map;
+	size_t							state = 13;
+	size_t							std_queries = queries / 10000;
+	double							start;
+
+	// the upkeep of the counts, against the fill of a plain ft::map
+	start = bench_now();
+	bench_fill(ft_map, n);
+	bench_report("fill ranked_map", "ft", n, (bench_now() - start) / n);
+	start = bench_now();
+	{
+		ft::map<size_t, size_t>	plain;
+
+		bench_fill(plain, n);
+		bench_report("fill map", "ft", n, (bench_now() - start) / n);
+	}
+	bench_fill(std_map, n);
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+		g_sink += ft_map.nth(bench_rand(state) % n)->first;
+	bench_report("nth", "ft", n, (bench_now() - start) / queries);
+	start = bench_now();
+	for (size_t i = 0; i < std_queries; i++)
+	{
+		std::map<size_t, size_t>::iterator	it = std_map.begin();
+
+		std::advance(it, bench_rand(state) % n);
+		g_sink += it->first;
+	}
+	bench_report("nth", "std", n, (bench_now() - start) / std_queries);
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+		g_sink += ft_map.rank(bench_rand(state) % (2 * n));
+	bench_report("rank", "ft", n, (bench_now() - start) / queries);
+	start = bench_now();
+	for (size_t i = 0; i < std_queries; i++)
+		g_sink += std::distance(std_map.begin(), std_map.lower_bound(bench_rand(state) % (2 * n)));
+	bench_report("rank", "std", n, (bench_now() - start) / std_queries);
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+		g_sink += ft_map.distance(ft_map.lower_bound(bench_rand(state) % n), ft_map.end());
+	bench_report("distance", "ft", n, (bench_now() - start) / queries);
+	start = bench_now();
+	for (size_t i = 0; i < std_queries; i++)
+		g_sink += std::distance(std_map.lower_bound(bench_rand(state) % n), std_map.end());
+	bench_report("distance", "std", n, (bench_now() - start) / std_queries);
+}
+
+// construction from random pairs: the range constructor inserts them one
+// by one, from_unsorted sorts them (on threads threads) and builds the tree
+template <typename Pair>
+static void	bench_from_unsorted(size_t n, size_t threads)
+{
+	std::vector<Pair>	pairs;
+	size_t				state = 23;
+	double				start;
+
+	for (size_t i = 0; i < n; i++)
+		pairs.push_back(Pair(bench_rand(state) % n, i));
+	start = bench_now();
+	{
+		ft::map<size_t, size_t>	map(pairs.begin(), pairs.end());
+
+		g_sink += map.size();
+		bench_report("range constructor", "ft", n, (bench_now() - start) / n);
+	}
+	start = bench_now();
+	{
+		ft::map<size_t, size_t>	map = ft::map<size_t, size_t>::from_unsorted(pairs.begin(),
+			pairs.end());
+
+		g_sink += map.size();
+		bench_report("from_unsorted 1 thread", "ft", n, (bench_now() - start) / n);
+	}
+	start = bench_now();
+	{
+		ft::map<size_t, size_t>	map = ft::map<size_t, size_t>::from_unsorted(
+			ft::parallel_execution(threads), pairs.begin(), pairs.end());
+
+		g_sink += map.size();
+		bench_report("from_unsorted threads", "ft", n, (bench_now() - start) / n);
+	}
+}
+
+// set algebra between a map of n keys and one of m keys, against the
+// loops of insert and erase a std::map needs (copies are not timed)
+static void	bench_set_algebra(size_t n, size_t m, size_t threads)
+{
+	ft::map<size_t, size_t>		ft_big;
+	ft::map<size_t, size_t>		ft_small;
+	std::map<size_t, size_t>	std_big;
+	std::map<size_t, size_t>	std_small;
+	size_t						state = 29;
+	size_t						key;
+	double						start;
+	std::ostringstream			name;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		key = bench_rand(state) % (2 * n);
+		ft_big.insert(ft::make_pair(key, i));
+		std_big.insert(std::make_pair(key, i));
+	}
+	for (size_t i = 0; i < m; i++)
+	{
+		key = bench_rand(state) % (2 * n);
+		ft_small.insert(ft::make_pair(key, i));
+		std_small.insert(std::make_pair(key, i));
+	}
+	name << "m=" << m << " t=" << threads;
+	{
+		ft::map<size_t, size_t>	ft_map(ft_big);
+		ft::map<size_t, size_t>	ft_other(ft_small);
+		std::map<size_t, size_t>	std_map(std_big);
+
+		start = bench_now();
+		ft_map.unite(ft::parallel_execution(threads), ft_other);
+		bench_report(("unite " + name.str()).c_str(), "ft", n, (bench_now() - start) / m);
+		start = bench_now();
+		std_map.insert(std_small.begin(), std_small.end());
+		bench_report(("unite " + name.str()).c_str(), "std", n, (bench_now() - start) / m);
+	}
+	{
+		ft::map<size_t, size_t>	ft_map(ft_big);
+		std::map<size_t, size_t>	std_map(std_big);
+
+		start = bench_now();
+		ft_map.intersect(ft::parallel_execution(threads), ft_small);
+		bench_report(("intersect " + name.str()).c_str(), "ft", n, (bench_now() - start) / m);
+		start = bench_now();
+		for (std::map<size_t, size_t>::iterator it = std_map.begin(); it != std_map.end(); )
+		{
+			if (std_small.count(it->first) == 0)
+				std_map.erase(it++);
+			else
+				++it;
+		}
+		bench_report(("intersect " + name.str()).c_str(), "std", n, (bench_now() - start) / m);
+	}
+	{
+		ft::map<size_t, size_t>	ft_map(ft_big);
+		std::map<size_t, size_t>	std_map(std_big);
+
+		start = bench_now();
+		ft_map.subtract(ft::parallel_execution(threads), ft_small);
+		bench_report(("subtract " + name.str()).c_str(), "ft", n, (bench_now() - start) / m);
+		start = bench_now();
+		for (std::map<size_t, size_t>::iterator it = std_small.begin(); it != std_small.end(); ++it)
+			std_map.erase(it->first);
+		bench_report(("subtract " + name.str()).c_str(), "std", n, (bench_now() - start) / m);
+	}
+}
+
+// sums over random key ranges: aggregate against iterating the range
+static void	bench_aggregate(size_t n, size_t queries)
+{
+	ft::aggregate_map<size_t, size_t>	agg_map;
+	ft::map<size_t, size_t>				ft_map;
+	ft::map<size_t, size_t>::iterator	last;
+	size_t								state = 19;
+	size_t								lo;
+	size_t								hi;
+	size_t								sum;
+	double								start;
+
+	start = bench_now();
+	bench_fill(agg_map, n);
+	bench_report("fill aggregate_map", "ft", n, (bench_now() - start) / n);
+	bench_fill(ft_map, n);
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+	{
+		lo = bench_rand(state) % (2 * n);
+		hi = lo + bench_rand(state) % (2 * n - lo);
+		g_sink += agg_map.aggregate(lo, hi);
+	}
+	bench_report("range sum aggregate", "ft", n, (bench_now() - start) / queries);
+	queries /= 100;
+	start = bench_now();
+	for (size_t i = 0; i < queries; i++)
+	{
+		lo = bench_rand(state) % (2 * n);
+		hi = lo + bench_rand(state) % (2 * n - lo);
+		sum = 0;
+		last = ft_map.lower_bound(hi);
+		for (ft::map<size_t, size_t>::iterator it = ft_map.lower_bound(lo); it != last; ++it)
+			sum += it->second;
+		g_sink += sum;
+	}
+	bench_report("range sum iterate", "ft", n, (bench_now() - start) / queries);
+}
+
+// a consistent view for readers while writes go on: one snapshot
+// followed by some writes, against a full copy of the map. then the
+// cost of the writes and of a scan without any snapshot around
+static void	bench_snapshot(size_t n, size_t writes, size_t rounds)
+{
+	typedef ft::persistent_map<size_t, size_t>	persistent_type;
+
+	persistent_type				persistent;
+	ft::map<size_t, size_t>		ft_map;
+	std::map<size_t, size_t>	std_map;
+	size_t						state = 23;
+	size_t						key;
+	double						start;
+
+	bench_fill(persistent, n);
+	bench_fill(ft_map, n);
+	bench_fill(std_map, n);
+	start = bench_now();
+	for (size_t r = 0; r < rounds; r++)
+	{
+		persistent_type	view = persistent.snapshot();
+
+		for (size_t i = 0; i < writes; i++)
+		{
+			key = bench_rand(state) % (2 * n);
+			persistent.insert_or_assign(key, i);
+		}
+		g_sink += view.size();
+	}
+	bench_report("snapshot and writes", "ft", n, (bench_now() - start) / rounds);
+	start = bench_now();
+	for (size_t r = 0; r < rounds; r++)
+	{
+		ft::map<size_t, size_t>	view(ft_map);
+
+		for (size_t i = 0; i < writes; i++)
+		{
+			key = bench_rand(state) % (2 * n);
+			ft_map[key] = i;
+		}
+		g_sink += view.size();
+	}
+	bench_report("copy and writes", "ft", n, (bench_now() - start) / rounds);
+	start = bench_now();
+	for (size_t r = 0; r < rounds; r++)
+	{
+		std::map<size_t, size_t>	view(std_map);
+
+		for (size_t i = 0; i < writes; i++)
+		{
+			key = bench_rand(state) % (2 * n);
+			std_map[key] = i;
+		}
+		g_sink += view.size();
+	}
+	bench_report("copy and writes", "std", n, (bench_now() - start) / rounds);
+	start = bench_now();
+	for (size_t i = 0; i < 100000; i++)
+	{
+		key = bench_rand(state) % (2 * n);
+		if (i % 2 == 0)
+			persistent.insert_or_assign(key, i);
+		else
+			persistent.erase(key);
+	}
+	bench_report("write no snapshot", "ft", n, (bench_now() - start) / 100000);
+	start = bench_now();
+	for (size_t i = 0; i < 100000; i++)
+	{
+		key = bench_rand(state) % (2 * n);
+		if (i % 2 == 0)
+			ft_map[key] = i;
+		else
+			ft_map.erase(key);
+	}
+	bench_report("write no snapshot", "ft map", n, (bench_now() - start) / 100000);
+	start = bench_now();
+	for (persistent_type::const_iterator it = persistent.begin(); it != persistent.end(); ++it)
+		g_sink += it->second;
+	bench_report("scan", "ft", n, (bench_now() - start) / n);
+	start = bench_now();
+	for (ft::map<size_t, size_t>::const_iterator it = ft_map.begin(); it != ft_map.end(); ++it)
+		g_sink += it->second;
+	bench_report("scan", "ft map", n, (bench_now() - start) / n);
+}
+
+// one thread of bench_read_mostly: lookups, and writes for write_permille
+// of the operations, half insertions and half erasures
+template <typename Map>
+struct bench_mixed_task
+{
+	Map*	map;
+	size_t	n;
+	size_t	ops;
+	size_t	write_permille;
+	size_t	state;
+	size_t	found;
+
+	void	operator()(void)
+	{
+		size_t	key;
+		size_t	value;
+
+		for (size_t i = 0; i < ops; i++)
+		{
+			key = bench_rand(state) % (2 * n);
+			if (bench_rand(state) % 1000 >= write_permille)
+				found += map->find(key, value);
+			else if (key % 4 == 0)
+				map->erase(key);
+			else
+				map->insert_or_assign(key, i);
+		}
+	}
+};
+
+// lookups shared by threads threads, with writes among them
+template <typename Map>
+static void	bench_read_mostly(const char* ns, size_t n, size_t threads,
+	size_t write_permille, size_t ops)
+{
+	typedef bench_mixed_task<Map>	task_type;
+
+	Map						map;
+	std::vector<task_type>	tasks;
+	std::ostringstream		name;
+	double					start;
+
+	for (size_t i = 0; i < n; i++)
+		map.insert_or_assign(i * 2, i);
+	for (size_t i = 0; i < threads; i++)
+	{
+		task_type	t = { &map, n, ops, write_permille, 29 + i, 0 };
+
+		tasks.push_back(t);
+	}
+	start = bench_now();
+	ft::run_parallel(&tasks[0], threads);
+	name << "reads " << (1000 - write_permille) / 10.0 << "% x" << threads;
+	bench_report(name.str().c_str(), ns, n, (bench_now() - start) / (ops * threads));
+	for (size_t i = 0; i < threads; i++)
+		g_sink += tasks[i].found;
+}
+
+// one thread of bench_read_latency: the writer updates until every
+// reader is done, a reader times each of its lookups
+template <typename Map>
+struct bench_latency_task
+{
+	Map*				map;
+	size_t				n;
+	size_t				queries;
+	bool				writer;
+	size_t*				readers_left;
+	size_t				state;
+	size_t				found;
+	std::vector<double>	latencies;
+
+	void	operator()(void)
+	{
+		size_t	key;
+		size_t	value;
+		double	start;
+
+		if (writer)
+		{
+			for (size_t i = 0; __atomic_load_n(readers_left, __ATOMIC_ACQUIRE) != 0; i++)
+			{
+				key = bench_rand(state) % (2 * n);
+				if (key % 4 == 0)
+					map->erase(key);
+				else
+					map->insert_or_assign(key, i);
+			}
+			return ;
+		}
+		latencies.reserve(queries);
+		for (size_t i = 0; i < queries; i++)
+		{
+			key = bench_rand(state) % (2 * n);
+			start = bench_now();
+			found += map->find(key, value);
+			latencies.push_back(bench_now() - start);
+		}
+		__atomic_sub_fetch(readers_left, 1, __ATOMIC_RELEASE);
+	}
+};
+
+// percentiles of the latency of the lookups of readers threads, while
+// one more thread writes without a pause. the times include the two
+// reads of the clock
+template <typename Map>
+static void	bench_read_latency(const char* ns, size_t n, size_t readers, size_t queries)
+{
+	typedef bench_latency_task<Map>	task_type;
+
+	static const double		percentiles[] = { 50, 90, 99, 99.9, 100 };
+	Map						map;
+	std::vector<task_type>	tasks;
+	std::vector<double>		all;
+	size_t					readers_left = readers;
+
+	for (size_t i = 0; i < n; i++)
+		map.insert_or_assign(i * 2, i);
+	for (size_t i = 0; i <= readers; i++)
+	{
+		task_type	t = { &map, n, queries, i == 0, &readers_left, 29 + i, 0, std::vector<double>() };
+
+		tasks.push_back(t);
+	}
+	ft::run_parallel(&tasks[0], readers + 1);
+	for (size_t i = 1; i <= readers; i++)
+	{
+		all.insert(all.end(), tasks[i].latencies.begin(), tasks[i].latencies.end());
+		g_sink += tasks[i].found;
+	}
+	std::sort(all.begin(), all.end());
+	for (size_t i = 0; i < sizeof(percentiles) / sizeof(*percentiles); i++)
+	{
+		std::ostringstream	name;
+
+		if (percentiles[i] == 100)
+			name << "read max";
+		else
+			name << "read p" << percentiles[i];
+		name << " x" << readers << " +w";
+		bench_report(name.str().c_str(), ns, n,
+			all[std::min(all.size() - 1, static_cast<size_t>(all.size() * percentiles[i] / 100))]);
+	}
+}
+
+// clear() alone, on a map filled in order
+template <typename Map>
+static void	bench_clear(const char* ns, size_t n)
+{
+	Map		map;
+	double	start;
+
+	for (size_t i = 0; i < n; i++)
+		map.insert(map.end(), typename Map::value_type(i, i));
+	start = bench_now();
+	map.clear();
+	std::cout << std::left << std::setw(24) << "clear" << std::setw(5) << ns
+		<< std::right << std::setw(10) << n
+		<< std::setw(12) << std::fixed << std::setprecision(1)
+		<< (bench_now() - start) / 1e6 << " ms" << std::endl;
+}
+
+void	map_bench(void)
+{
+	typedef ft::map<size_t, size_t>		ft_map;
+	typedef std::map<size_t, size_t>	std_map;
+
+	// bounds: keys are the even numbers in [0, 2n), queries hit and miss
+	for (size_t n = 1000; n <= 1000000; n *= 10)
+	{
+		bench_bounds<ft_map>("ft", n, 200000);
+		bench_bounds<std_map>("std", n, 200000);
+	}
+	// lookups with borrowed keys
+	for (size_t n = 1000; n <= 100000; n *= 100)
+	{
+		bench_borrowed_lookup<ft::map<std::string, size_t, bench_string_less>,
+			bench_string_ref>("find borrowed (transp)", "ft", n, 500000);
+		bench_borrowed_lookup<ft::map<std::string, size_t>, const char*>
+			("find const char*", "ft", n, 500000);
+		bench_borrowed_lookup<std::map<std::string, size_t>, const char*>
+			("find const char*", "std", n, 500000);
+	}
+	// sorted ingest
+	for (size_t n = 10000; n <= 1000000; n *= 10)
+	{
+		bench_sorted_ingest<ft_map>("ft", n);
+		bench_sorted_ingest<std_map>("std", n);
+	}
+
+	// sorted range construction (destruction included)
+	for (size_t n = 10000; n <= 1000000; n *= 10)
+	{
+		bench_sorted_build<ft_map, ft::pair<size_t, size_t> >("ft", n);
+		bench_sorted_build<std_map, std::pair<size_t, size_t> >("std", n);
+	}
+
+	// insert cost
+	for (size_t n = 1000; n <= 1000000; n *= 1000)
+	{
+		bench_insert_cost<ft::map<size_t, size_t, bench_counting_less<size_t> > >("ft", n);
+		bench_insert_cost<std::map<size_t, size_t, bench_counting_less<size_t> > >("std", n);
+	}
+
+	// allocator churn
+	bench_churn<ft_map>("churn std::allocator", "ft", 100000, 1000000);
+	bench_churn<ft::map<size_t, size_t, std::less<size_t>,
+		ft::pool_allocator<ft::pair<const size_t, size_t> > > >
+		("churn pool_allocator", "ft", 100000, 1000000);
+	bench_churn<std_map>("churn std::allocator", "std", 100000, 1000000);
+
+	// range erase
+	for (size_t n = 100000; n <= 1000000; n *= 10)
+	{
+		bench_range_erase<ft_map>("ft", n);
+		bench_range_erase<std_map>("std", n);
+	}
+
+	// split and join
+	for (size_t n = 10000; n <= 1000000; n *= 10)
+		bench_split_join(n, 100);
+
+	// batched lookup, up to a map far larger than the last level cache
+	for (size_t n = 10000; n <= 10000000; n *= 10)
+		bench_find_many<ft_map>(n, 32, 2000000);
+
+	// order statistics
+	for (size_t n = 10000; n <= 1000000; n *= 10)
+		bench_order_statistics(n, 1000000);
+
+	// bulk construction, destruction included
+	for (size_t n = 100000; n <= 10000000; n *= 10)
+		bench_from_unsorted<ft::pair<size_t, size_t> >(n, 8);
+
+	// set algebra, per key of the smaller map
+	for (size_t m = 1000; m <= 1000000; m *= 1000)
+	{
+		bench_set_algebra(1000000, m, 1);
+		bench_set_algebra(1000000, m, 8);
+	}
+
+	// range aggregates
+	for (size_t n = 10000; n <= 1000000; n *= 10)
+		bench_aggregate(n, 100000);
+
+	// snapshots, per snapshot taken then 100 writes
+	for (size_t n = 10000; n <= 1000000; n *= 10)
+		bench_snapshot(n, 100, 100);
+
+	// lookups shared between threads, per operation of all threads
+	for (size_t threads = 1; threads <= bench_threads(); threads *= 2)
+	{
+		for (size_t permille = 0; permille <= 100; permille += permille ? 90 : 10)
+		{
+			bench_read_mostly<ft::concurrent_map<size_t, size_t> >("seq", 1000000,
+				threads, permille, 1000000);
+			bench_read_mostly<bench_locked_map>("mutex", 1000000, threads, permille, 1000000);
+		}
+	}
+
+	// write heavy mixes, per operation of all threads
+	for (size_t threads = 1; threads <= bench_threads(); threads *= 2)
+	{
+		for (size_t permille = 500; permille <= 1000; permille += 500)
+		{
+			bench_read_mostly<ft::sharded_map<size_t, size_t, 16> >("shard", 1000000,
+				threads, permille, 1000000);
+			bench_read_mostly<bench_locked_map>("mutex", 1000000, threads, permille, 1000000);
+		}
+	}
+
+	// read latency under a writer that never stops
+	for (size_t readers = 1; readers <= 4; readers *= 4)
+	{
+		bench_read_latency<ft::rcu_map<size_t, size_t> >("rcu", 100000, readers, 1000000);
+		bench_read_latency<ft::concurrent_map<size_t, size_t> >("seq", 100000, readers, 1000000);
+		bench_read_latency<bench_locked_map>("mutex", 100000, readers, 1000000);
+	}
+
+	// clear
+	for (size_t n = 1000000; n <= 10000000; n *= 10)
+	{
+		bench_clear<ft_map>("ft", n);
+		bench_clear<ft::map<size_t, size_t, std::less<size_t>,
+			ft::pool_allocator<ft::pair<const size_t, size_t> > > >("pool", n);
+		bench_clear<std_map>("std", n);
+	}
+
+	// empty maps
+	bench_empty<ft::map<size_t, size_t, std::less<size_t>,
+		bench_counting_allocator<ft::pair<const size_t, size_t> > > >("ft", 1000000);
+	bench_empty<std::map<size_t, size_t, std::less<size_t>,
+		bench_counting_allocator<std::pair<const size_t, size_t> > > >("std", 1000000);
+
+	// node footprint
+	bench_footprint<ft::map<size_t, size_t, std::less<size_t>,
+		bench_counting_allocator<ft::pair<const size_t, size_t> > > >
+		("footprint<size_t>", "ft", 100000, bench_size);
+	bench_footprint<std::map<size_t, size_t, std::less<size_t>,
+		bench_counting_allocator<std::pair<const size_t, size_t> > > >
+		("footprint<size_t>", "std", 100000, bench_size);
+	bench_footprint<ft::map<std::string, std::string, std::less<std::string>,
+		bench_counting_allocator<ft::pair<const std::string, std::string> > > >
+		("footprint<string>", "ft", 100000, bench_string);
+	bench_footprint<std::map<std::string, std::string, std::less<std::string>,
+		bench_counting_allocator<std::pair<const std::string, std::string> > > >
+		("footprint<string>", "std", 100000, bench_string);
+
+	if (g_sink == 42)
+		std::cout << std::endl;
+}
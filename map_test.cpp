@@ -80,6 +80,123 @@ void	map_test(void)
 
 	outfile << std::endl;
 
+	// Range construction and insertion
+	{
+		typedef NS::map<size_t, size_t>		map_type;
+		typedef NS::pair<size_t, size_t>	pair_type;
+
+		std::vector<pair_type>	sorted;
+		std::vector<pair_type>	unsorted;
+
+		for (size_t i = 0; i < 100; i++)
+			sorted.push_back(NS::make_pair(i, i * 3));
+		for (size_t i = 0; i < 100; i++)
+			unsorted.push_back(NS::make_pair((i * 37) % 50, i));
+
+		map_type	from_sorted(sorted.begin(), sorted.end());
+		map_type	from_unsorted(unsorted.begin(), unsorted.end());
+		map_type	from_map(from_sorted.begin(), from_sorted.end());
+		map_type	from_empty(sorted.begin(), sorted.begin());
+
+		print_map(outfile, from_sorted);
+		print_map(outfile, from_unsorted);
+		print_map(outfile, from_map);
+		outfile << from_empty.size() << std::endl;
+
+		// sorted insertion into an empty and into a non empty map
+		from_empty.insert(sorted.begin() + 50, sorted.end());
+		from_unsorted.insert(sorted.begin() + 25, sorted.end());
+		print_map(outfile, from_empty);
+		print_map(outfile, from_unsorted);
+	}
+
+	outfile << std::endl;
+
+	// Copy and assignment
+	{
+		typedef NS::map<size_t, size_t>	map_type;
+
+		map_type	big;
+		map_type	small;
+
+		fill_map(big, 50);
+		fill_map(small, 5);
+
+		// copy constructor
+		map_type	copy(big);
+		print_map(outfile, copy);
+
+		// assignment to a smaller, a bigger, the same and an empty map
+		copy = small;
+		print_map(outfile, copy);
+		copy = big;
+		print_map(outfile, copy);
+		map_type&	self = copy;
+		copy = self;
+		print_map(outfile, copy);
+		copy = map_type();
+		outfile << copy.size() << std::endl;
+
+		// the copy does not share nodes with the original
+		small = big;
+		small.erase(10);
+		small[100] = 100;
+		outfile << big.size() << " " << small.size() << std::endl;
+		print_map(outfile, small);
+	}
+
+	// a copy that throws midway frees what was copied
+	{
+		typedef NS::map<size_t, throwing_value>	map_type;
+
+		map_type	from;
+		map_type	to;
+		size_t		live;
+
+		for (size_t i = 0; i < 100; i++)
+			from.insert(NS::make_pair(i, throwing_value(i)));
+		for (size_t i = 0; i < 80; i++)
+			to.insert(NS::make_pair(i, throwing_value(i)));
+		live = throwing_value::live();
+		throwing_value::budget() = 50;
+		try {
+			map_type	copy(from);
+		} catch (std::exception& e) {
+			outfile << "copy threw exception" << std::endl;
+		}
+		outfile << throwing_value::live() - live << std::endl;
+		throwing_value::budget() = 50;
+		try {
+			to = from;
+		} catch (std::exception& e) {
+			outfile << "assignment threw exception" << std::endl;
+		}
+		throwing_value::budget() = 0;
+		outfile << throwing_value::live() - to.size() - from.size() << std::endl;
+	}
+
+	// and so does a construction from a sorted range
+	{
+		typedef NS::map<size_t, throwing_value>	map_type;
+
+		std::vector<NS::pair<size_t, throwing_value> >	pairs;
+		size_t											live;
+
+		for (size_t i = 0; i < 100; i++)
+			pairs.push_back(NS::make_pair(i, throwing_value(i)));
+		live = throwing_value::live();
+		throwing_value::budget() = 50;
+		try {
+			map_type	map(pairs.begin(), pairs.end());
+		} catch (std::exception& e) {
+			outfile << "construction threw exception" << std::endl;
+		}
+		throwing_value::budget() = 0;
+		outfile << throwing_value::live() - live << std::endl;
+	}
+
+	outfile << std::endl;
+
 	// Modifiers
 	{
 		typedef NS::map<size_t, size_t>	map_type;
@@ -93,6 +210,16 @@ void	map_test(void)
 		map.insert(map.begin(), NS::make_pair(0, 0));
 		map.insert(map.end(), NS::make_pair(1, 1));
 
+		// insert with hints that are right, wrong, or point to the key itself
+		for (size_t i = 10; i < 20; i++)
+			PRINT_NODE(outfile, map.insert(map.end(), NS::make_pair(i, i)));
+		for (size_t i = 40; i > 30; i--)
+			PRINT_NODE(outfile, map.insert(map.find(10), NS::make_pair(i, i)));
+		for (size_t i = 20; i < 30; i++)
+			PRINT_NODE(outfile, map.insert(map.begin(), NS::make_pair(i, i)));
+		PRINT_NODE(outfile, map.insert(map.find(15), NS::make_pair(15, 0)));
+		print_map(outfile, map);
+
 		outfile << std::endl;
 
 		// erase
@@ -115,6 +242,60 @@ void	map_test(void)
 
 	outfile << std::endl;
 
+	// Range erase
+	{
+		typedef NS::map<size_t, size_t>	map_type;
+
+		map_type	map;
+
+		fill_map(map, 5000);
+		// short and long ranges, at the front, in the middle, at the back
+		map.erase(map.find(10), map.find(20));
+		map.erase(map.begin(), map.find(1000));
+		map.erase(map.find(1500), map.find(3500));
+		map.erase(map.find(4990), map.end());
+		map.erase(map.find(4000), map.find(4000));
+		outfile << map.size() << " " << map.begin()->first << " "
+			<< (--map.end())->first << std::endl;
+		for (map_type::iterator it = map.find(1495); it != map.find(3505); ++it)
+			PRINT_NODE(outfile, it);
+		// the tree is still usable after the ranges were split out
+		fill_map(map, 1200);
+		map.erase(map.find(1100), map.find(4500));
+		outfile << map.size() << std::endl;
+		print_map(outfile, map);
+		map.erase(map.begin(), map.end());
+		if (map.empty() && map.begin() == map.end())
+			outfile << "all erased" << std::endl;
+	}
+	// a range is erased without comparing keys, so a throwing comparator
+	// cannot leave the tree half split
+	{
+		typedef NS::map<size_t, size_t, throwing_less>	map_type;
+
+		map_type			map;
+		map_type::iterator	first;
+		map_type::iterator	last;
+
+		fill_map(map, 500);
+		first = map.find(100);
+		last = map.find(400);
+		throwing_less::budget() = 1;
+		try {
+			map.erase(first, last);
+			map.erase(map.begin(), map.begin());
+			map.erase(--map.end(), map.end());
+			outfile << "range erase did not compare" << std::endl;
+		} catch (std::exception& e) {
+			outfile << "range erase threw exception" << std::endl;
+		}
+		throwing_less::budget() = 0;
+		outfile << map.size() << std::endl;
+		print_map(outfile, map);
+	}
+
+	outfile << std::endl;
+
 	// Lookup
 	{
 		NS::map<size_t, size_t>	map;
@@ -135,7 +316,768 @@ void	map_test(void)
 
 		// upper bound
 		PRINT_NODE(outfile, map.lower_bound(5));
+
+		outfile << std::endl;
+
+		// bounds and equal_range on keys that are absent from the map
+		map.erase(50);
+		PRINT_NODE(outfile, map.upper_bound(5));
+		PRINT_NODE(outfile, map.lower_bound(50));
+		PRINT_NODE(outfile, map.upper_bound(50));
+		PRINT_NODE(outfile, map.equal_range(5).first);
+		PRINT_NODE(outfile, map.equal_range(5).second);
+		if (map.equal_range(50).first == map.equal_range(50).second)
+			outfile << "equal_range(50) is empty" << std::endl;
+		if (map.lower_bound(1000) == map.end())
+			outfile << "lower_bound(1000) is end" << std::endl;
+		outfile << map.count(50) << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Pool allocator
+	{
+		typedef NS::map<size_t, size_t, std::less<size_t>,
+			ft::pool_allocator<NS::pair<const size_t, size_t> > >	map_type;
+
+		map_type	map;
+
+		// enough nodes for several blocks, recycled through the free list
+		fill_map(map, 5000);
+		for (size_t i = 0; i < 5000; i += 2)
+			map.erase(i);
+		fill_map(map, 6000);
+		outfile << map.size() << std::endl;
+
+		map_type	copy(map);
+		map_type	other;
+
+		other = copy;
+		other.swap(map);
+		copy.clear();
+		fill_map(copy, 10);
+		print_map(outfile, copy);
+		outfile << map.size() << " " << other.size() << std::endl;
+		other.clear();
+		map.clear();
+		if (map.empty() && other.empty())
+			outfile << "maps were cleared" << std::endl;
+
+		// emptied and filled again, one element at a time too
+		for (size_t i = 0; i < 100; i++)
+		{
+			map.insert(NS::make_pair(i, i));
+			map.erase(i);
+		}
+		fill_map(map, 3000);
+		for (size_t i = 0; i < 3000; i++)
+			map.erase(i);
+		fill_map(map, 50);
+		print_map(outfile, map);
+	}
+
+	// copies of a const allocator made from several threads share one pool
+	{
+		typedef ft::pool_allocator<size_t>	allocator_type;
+
+		const allocator_type				alloc;
+		allocator_copy_task<allocator_type>	tasks[4];
+		size_t								shared = 0;
+		size_t*								p;
+
+		for (size_t i = 0; i < 4; i++)
+			tasks[i]._from = &alloc;
+		run_tasks(tasks, 4);
+		for (size_t i = 0; i < 4; i++)
+			shared += (tasks[i]._copy == alloc);
+		p = tasks[0]._copy.allocate(1);
+		tasks[3]._copy.deallocate(p, 1);
+		outfile << shared << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Empty maps and keys without a default constructor
+	{
+		typedef NS::map<explicit_key, std::string>	map_type;
+
+		map_type	map;
+		map_type	other;
+
+		if (map.begin() == map.end() && map.rbegin() == map.rend())
+			outfile << "empty map" << std::endl;
+		map.swap(other);
+		map.insert(NS::make_pair(explicit_key(2), std::string("two")));
+		map.insert(NS::make_pair(explicit_key(1), std::string("one")));
+		// the nodes of map must follow it into other and back
+		other.swap(map);
+		outfile << map.size() << " " << other.size() << std::endl;
+		print_map(outfile, other);
+		outfile << (--other.end())->first << std::endl;
+		map.swap(other);
+		print_map(outfile, map);
+		if (other.begin() == other.end())
+			outfile << "swapped back" << std::endl;
+		map.erase(map.begin());
+		map.erase(map.begin());
+		if (map.empty() && map.begin() == map.end())
+			outfile << "emptied" << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Emplace and assign
+	{
+		typedef NS::map<size_t, std::string>	map_type;
+
+		map_type				map;
+		map_type::iterator		it;
+		NS::pair<map_type::iterator, bool>	ret;
+
+		ret = map_try_emplace(map, 3, "three");
+		outfile << ret.first->second << " " << ret.second << std::endl;
+		ret = map_try_emplace(map, 3, "drei");
+		outfile << ret.first->second << " " << ret.second << std::endl;
+		ret = map_insert_or_assign(map, 3, "trois");
+		outfile << ret.first->second << " " << ret.second << std::endl;
+		ret = map_insert_or_assign(map, 1, "one");
+		outfile << ret.first->second << " " << ret.second << std::endl;
+		// good, bad and missing hints
+		it = map_emplace_hint(map, map.end(), 5, "five");
+		outfile << it->first << std::endl;
+		it = map_emplace_hint(map, map.begin(), 4, std::string("four"));
+		outfile << it->first << std::endl;
+		it = map_emplace_hint(map, map.find(3), 2, "two");
+		outfile << it->first << std::endl;
+		it = map_emplace_hint(map, map.find(3), 3, "tres");
+		outfile << it->second << std::endl;
+		// operator[] only adds a value for missing keys
+		map[6];
+		map[1] += "!";
+		outfile << map.size() << " " << map[6].empty() << std::endl;
+		print_map(outfile, map);
+	}
+
+	outfile << std::endl;
+
+	// Node handles
+	{
+		typedef NS::map<size_t, std::string>	map_type;
+
+		map_type	map;
+		map_type	other;
+
+		for (size_t i = 0; i < 20; i++)
+			map_try_emplace(map, i, std::string(i, 'x'));
+		for (size_t i = 10; i < 40; i += 4)
+			map_try_emplace(other, i, "other");
+		outfile << map_move_node(other, map, 3, 3) << std::endl;
+		outfile << map_move_node(other, map, 5, 100) << std::endl;
+		outfile << map_move_node(other, map, 6, 14) << std::endl;
+		outfile << map_move_node(other, map, 50, 51) << std::endl;
+		outfile << map.size() << " " << other.size() << std::endl;
+		map_merge(other, map);
+		print_map(outfile, map);
+		print_map(outfile, other);
+		map_merge(map, other);
+		outfile << map.size() << " " << other.size() << std::endl;
+		print_map(outfile, other);
+	}
+
+	// hinted node insertions, between maps of equal and unequal allocators
+	{
+		typedef NS::map<size_t, std::string>	map_type;
+		typedef NS::map<size_t, std::string, std::less<size_t>,
+			ft::pool_allocator<NS::pair<const size_t, std::string> > >	pool_map_type;
+
+		map_type		map;
+		map_type		other;
+		pool_map_type	pool_map;
+		pool_map_type	pool_other;
+
+		for (size_t i = 0; i < 10; i++)
+		{
+			map_try_emplace(map, i, std::string(i, 'x'));
+			map_try_emplace(pool_map, i, std::string(i, 'x'));
+		}
+		map_try_emplace(other, 4, "other");
+		map_try_emplace(pool_other, 4, "other");
+		outfile << map_move_node_hint(other, map, 4) << map_move_node_hint(other, map, 7)
+			<< map_move_node_hint(other, map, 42) << std::endl;
+		outfile << map_move_node_hint(pool_other, pool_map, 4)
+			<< map_move_node_hint(pool_other, pool_map, 7) << std::endl;
+		print_map(outfile, map);
+		print_map(outfile, other);
+		print_map(outfile, pool_map);
+		print_map(outfile, pool_other);
+	}
+
+	outfile << std::endl;
+
+	// Split and join
+	{
+		typedef NS::map<size_t, size_t>	map_type;
+
+		map_type	map;
+		map_type	upper;
+		map_type	empty;
+
+		fill_map(map, 1000);
+		upper = map_split(map, 600);
+		outfile << map.size() << " " << upper.size() << std::endl;
+		outfile << (--map.end())->first << " " << upper.begin()->first << std::endl;
+		// splits at either end leave one side empty
+		empty = map_split(map, 5000);
+		outfile << map.size() << " " << empty.size() << std::endl;
+		// the parts stay usable, and join back in either order
+		map.erase(map.begin(), map.find(100));
+		upper.insert(NS::make_pair(2000, 0));
+		map_join(upper, map);
+		outfile << upper.size() << " " << map.size() << std::endl;
+		map = map_split(upper, 0);
+		outfile << upper.size() << " " << map.size() << std::endl;
+		map_join(map, empty);
+		upper = map_split(map, 300);
+		map_join(map, upper);
+		outfile << map.size() << " " << upper.size() << std::endl;
+		// overlapping maps are merged
+		fill_map(upper, 120);
+		map_join(map, upper);
+		outfile << map.size() << " " << upper.size() << std::endl;
+		print_map(outfile, upper);
+		outfile << map.begin()->first << " " << (--map.end())->first << std::endl;
+	}
+	// a comparator that throws during a split leaves the map as it was
+	{
+		typedef NS::map<size_t, size_t, throwing_less>	map_type;
+
+		map_type	map;
+		map_type	upper;
+
+		fill_map(map, 500);
+		throwing_less::budget() = 5;
+		try {
+			upper = map_split(map, 250);
+			outfile << "split did not throw" << std::endl;
+		} catch (std::exception& e) {
+			outfile << "split threw exception" << std::endl;
+		}
+		throwing_less::budget() = 0;
+		outfile << map.size() << " " << upper.size() << std::endl;
+		print_map(outfile, map);
+		upper = map_split(map, 250);
+		outfile << map.size() << " " << upper.size() << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Order statistics
+	{
+		typedef NS::RANKED_MAP<size_t, size_t>	map_type;
+
+		map_type		map;
+		const map_type&	cmap = map;
+		map_type		upper;
+
+		outfile << (map_nth(cmap, 0) == cmap.end()) << " " << map_rank(cmap, 5) << std::endl;
+		for (size_t i = 0; i < 500; i++)
+			map.insert(NS::make_pair((i * 7919) % 1000, i));
+		outfile << map_nth(cmap, 0)->first << " " << map_nth(cmap, 250)->first << " "
+			<< map_nth(cmap, 499)->first << std::endl;
+		outfile << (map_nth(cmap, 500) == cmap.end()) << std::endl;
+		outfile << map_rank(cmap, 0) << " " << map_rank(cmap, 501) << " "
+			<< map_rank(cmap, 5000) << std::endl;
+		outfile << map_distance(cmap, cmap.begin(), cmap.end()) << " "
+			<< map_distance(cmap, cmap.lower_bound(400), cmap.end()) << std::endl;
+		// the counts follow erasures, copies, splits and joins
+		map.erase(map.begin(), map.lower_bound(300));
+		map.erase(map.lower_bound(600), map.lower_bound(700));
+		map.erase(map.upper_bound(900));
+		for (size_t k = 0; k < map.size(); k += 37)
+			outfile << map_nth(cmap, k)->first << " ";
+		outfile << std::endl;
+		upper = map_split(map, 650);
+		outfile << map_nth(cmap, 10)->first << " " << map_rank(upper, 800) << std::endl;
+		map_join(upper, map);
+		map = upper;
+		outfile << map_rank(cmap, 650) << " "
+			<< map_distance(cmap, cmap.lower_bound(500), cmap.lower_bound(800)) << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Batched lookup
+	{
+		typedef NS::map<size_t, size_t>	map_type;
+
+		map_type							map;
+		const map_type&						cmap = map;
+		std::vector<size_t>					keys;
+		std::vector<map_type::const_iterator>	found;
+
+		map_find_many(cmap, keys.begin(), keys.end(), std::back_inserter(found));
+		outfile << found.size() << std::endl;
+		keys.push_back(3);
+		map_find_many(cmap, keys.begin(), keys.end(), std::back_inserter(found));
+		outfile << (found[0] == cmap.end()) << std::endl;
+		found.clear();
+		// more keys than lanes, hits and misses mixed, repeated keys
+		for (size_t i = 0; i < 300; i++)
+			map.insert(NS::make_pair(i * 3, i));
+		for (size_t i = 0; i < 70; i++)
+			keys.push_back((i * 37) % 1000);
+		map_find_many(cmap, keys.begin(), keys.end(), std::back_inserter(found));
+		outfile << found.size() << std::endl;
+		for (size_t i = 0; i < found.size(); i++)
+		{
+			if (found[i] == cmap.end())
+				outfile << "- ";
+			else
+				outfile << found[i]->second << " ";
+		}
+		outfile << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Range aggregates
+	{
+		typedef NS::AGGREGATE_MAP<int, long>	map_type;
+
+		map_type		map;
+		const map_type&	cmap = map;
+		map_type		upper;
+
+		outfile << map_aggregate(cmap, 0, 100) << std::endl;
+		for (int i = 0; i < 400; i++)
+			map.insert(NS::make_pair((i * 7919) % 1000, static_cast<long>(i)));
+		outfile << map_aggregate(cmap, 0, 1000) << " " << map_aggregate(cmap, 100, 200) << " "
+			<< map_aggregate(cmap, 500, 500) << " " << map_aggregate(cmap, 900, 100) << " "
+			<< map_aggregate(cmap, -50, 5) << " " << map_aggregate(cmap, 990, 2000) << std::endl;
+		// the sums follow the values assigned and written in place
+		map_insert_or_assign(map, 101, 1000L);
+		map_insert_or_assign(map, 102, 1000L);
+		map.lower_bound(150)->second = 7;
+		map_refresh(map, map.lower_bound(150));
+		outfile << map_aggregate(cmap, 100, 200) << " " << map.at(101) << std::endl;
+		// and the erasures, splits and joins
+		map.erase(map.lower_bound(120), map.lower_bound(600));
+		map.erase(102);
+		upper = map_split(map, 800);
+		outfile << map_aggregate(cmap, 0, 1000) << " " << map_aggregate(upper, 0, 1000) << std::endl;
+		map_join(map, upper);
+		outfile << map_aggregate(cmap, 100, 900) << " " << map.size() << std::endl;
+	}
+
+	// with the comparator the map was given, here in descending order
+	{
+		typedef aggregate_map_type<int, long, directed_less>::type	map_type;
+
+		map_type	map((directed_less(true)));
+
+		for (int i = 0; i < 100; i++)
+			map.insert(NS::make_pair(i, static_cast<long>(i)));
+		outfile << map.key_comp()(1, 2) << " " << map.begin()->first << std::endl;
+		outfile << map_aggregate(map, 50, 40) << " " << map_aggregate(map, 40, 50) << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Bulk construction from unsorted pairs
+	{
+		typedef NS::map<size_t, size_t>	map_type;
+
+		std::vector<map_type::value_type>	pairs;
+		map_type							map;
+
+		map = map_from_unsorted<map_type>(pairs.begin(), pairs.end(), 4);
+		outfile << map.size() << std::endl;
+		// equivalent keys keep their first value, whatever the threads
+		for (size_t i = 0; i < 20000; i++)
+			pairs.push_back(NS::make_pair((i * 7919) % 15000, i));
+		for (size_t threads = 1; threads <= 4; threads += 3)
+		{
+			map = map_from_unsorted<map_type>(pairs.begin(), pairs.end(), threads);
+			outfile << map.size() << " " << map.begin()->second << " "
+				<< map.find(7919)->second << " " << (--map.end())->second << std::endl;
+			for (map_type::iterator it = map.begin(); it != map.end(); it++)
+			{
+				if (it->first % 1000 == 0)
+					PRINT_NODE(outfile, it);
+			}
+		}
+		map.insert(NS::make_pair(100000, 1));
+		outfile << map.size() << std::endl;
+
+		// a ranked map is built as a ranked map
+		typedef NS::RANKED_MAP<size_t, size_t>	ranked_type;
+
+		ranked_type	ranked = map_from_unsorted<ranked_type>(pairs.begin(), pairs.end(), 2);
+
+		outfile << map_nth(ranked, 1234)->first << " " << map_rank(ranked, 7919) << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Set algebra
+	{
+		typedef NS::map<size_t, size_t>	map_type;
+
+		map_type	map;
+		map_type	other;
+		map_type	empty;
+
+		for (size_t threads = 1; threads <= 4; threads += 3)
+		{
+			map.clear();
+			other.clear();
+			for (size_t i = 0; i < 30000; i++)
+			{
+				map.insert(NS::make_pair((i * 7919) % 45000, i));
+				other.insert(NS::make_pair((i * 104729) % 60000, i + 1));
+			}
+			map_type	inter(map);
+			map_type	diff(map);
+
+			map_intersect(inter, other, threads);
+			map_subtract(diff, other, threads);
+			map_unite(map, other, threads);
+			outfile << map.size() << " " << other.size() << " " << inter.size() << " "
+				<< diff.size() << std::endl;
+			for (size_t k = 0; k < 60000; k += 4999)
+			{
+				outfile << (map.count(k) ? map.find(k)->second : 0) << " "
+					<< (inter.count(k) ? inter.find(k)->second : 0) << " "
+					<< diff.count(k) << std::endl;
+			}
+		}
+		// with empty maps on either side
+		map_intersect(map, empty, 2);
+		outfile << map.size() << std::endl;
+		fill_map(map, 10);
+		map_unite(empty, map, 2);
+		map_subtract(empty, empty, 1);
+		outfile << empty.size() << " " << map.size() << std::endl;
 	}
+	// a comparator that throws midway, on one thread or several, leaks
+	// nothing, and leaves maps that can still be used
+	{
+		typedef NS::map<size_t, throwing_value, throwing_less>	map_type;
+
+		for (size_t threads = 1; threads <= 4; threads += 3)
+		{
+			for (int op = 0; op < 3; op++)
+			{
+				map_type	map;
+				map_type	other;
+
+				for (size_t i = 0; i < 30000; i++)
+				{
+					map.insert(NS::make_pair((i * 7919) % 45000, throwing_value(i)));
+					other.insert(NS::make_pair((i * 104729) % 60000, throwing_value(i)));
+				}
+				throwing_less::budget() = 5000;
+				try {
+					if (op == 0)
+						map_unite(map, other, threads);
+					else if (op == 1)
+						map_intersect(map, other, threads);
+					else
+						map_subtract(map, other, threads);
+					outfile << "set operation did not throw" << std::endl;
+				} catch (std::exception& e) {
+					outfile << "set operation threw exception" << std::endl;
+				}
+				throwing_less::budget() = 0;
+				outfile << throwing_value::live() - map.size() - other.size() << std::endl;
+				map.insert(NS::make_pair(1, throwing_value(1)));
+				outfile << map.count(1) << std::endl;
+			}
+		}
+	}
+
+	outfile << std::endl;
+
+	// Persistent snapshots
+	{
+		typedef NS::PERSISTENT_MAP<size_t, std::string>	map_type;
+
+		map_type				map;
+		std::vector<map_type>	versions;
+
+		for (size_t i = 0; i < 2000; i++)
+		{
+			map.insert(NS::make_pair((i * 7919) % 3000, std::string(i % 7 + 1, 'a' + i % 26)));
+			if (i % 3 == 0)
+				map.erase((i * 104729) % 3000);
+			if (i % 5 == 0)
+				map_insert_or_assign(map, i % 3000, std::string("assigned"));
+			if (i % 400 == 0)
+				versions.push_back(map_snapshot(map));
+		}
+		versions.push_back(map_snapshot(map));
+		map.clear();
+		for (size_t v = 0; v < versions.size(); v++)
+		{
+			map_type::const_iterator	it = versions[v].begin();
+
+			outfile << versions[v].size() << " " << (versions[v] == versions.back()) << std::endl;
+			for (size_t k = 0; it != versions[v].end(); ++it, k++)
+			{
+				if (k % 97 == 0)
+					PRINT_NODE(outfile, it);
+			}
+		}
+		map = versions[2];
+		map.erase(map.begin());
+		map.insert(NS::make_pair(size_t(5000), std::string("last")));
+		outfile << map.size() << " " << versions[2].size() << " " << (map != versions[2])
+			<< " " << map.rbegin()->first << " " << versions[2].rbegin()->first << std::endl;
+		outfile << map.at(5000) << " " << versions[2].count(5000) << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Concurrent map, from a single thread
+	{
+		typedef NS::CONCURRENT_MAP<int, long>	map_type;
+
+		map_type	map;
+		long		value = 0;
+		bool		found;
+
+		for (int i = 0; i < 3000; i++)
+		{
+			map_store(map, (i * 7919) % 2000, static_cast<long>(i));
+			if (i % 3 == 0)
+				map.erase((i * 31) % 2000);
+		}
+		map.insert(NS::make_pair(5000, -1L));
+		map.insert(NS::make_pair(0, -2L));
+		outfile << map.size() << " " << map.empty() << std::endl;
+		for (int k = 0; k < 2000; k += 37)
+		{
+			found = map_find_copy(map, k, value);
+			outfile << k << " " << found << " " << (found ? value : -1) << " "
+				<< map.count(k) << std::endl;
+		}
+		print_map(outfile, map_copy(map));
+		map.clear();
+		outfile << map.size() << " " << map.empty() << " " << map_find_copy(map, 5000, value)
+			<< " " << value << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Concurrent map, from several threads
+	{
+		typedef NS::CONCURRENT_MAP<int, long>	map_type;
+
+		map_type			map;
+		map_task<map_type>	tasks[6];
+		int					done = 0;
+		size_t				bad = 0;
+		long				sum = 0;
+		long				value;
+
+		// the writers come first: for std, the readers run once they are done
+		for (int i = 0; i < 6; i++)
+		{
+			tasks[i]._map = &map;
+			tasks[i]._done = &done;
+			tasks[i]._id = i;
+			tasks[i]._writers = 3;
+			tasks[i]._keys = 30000;
+			tasks[i]._reader = (i >= 3);
+		}
+		run_tasks(tasks, 6);
+		for (int i = 0; i < 6; i++)
+			bad += tasks[i]._bad;
+		for (int k = 0; k < 30000; k++)
+			sum += (map_find_copy(map, k, value) ? value : 0);
+		outfile << map.size() << " " << map_copy(map).size() << " " << bad << " " << sum
+			<< " " << map.count(29999) << " " << map.count(29997) << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Sharded map, from a single thread
+	{
+		typedef NS::SHARDED_MAP<int, long>	map_type;
+
+		map_type	map;
+		long		value = 0;
+		bool		found;
+
+		for (int i = 0; i < 3000; i++)
+		{
+			map_store(map, (i * 7919) % 2000, static_cast<long>(i));
+			if (i % 3 == 0)
+				map.erase((i * 31) % 2000);
+			if (i % 7 == 0)
+				map_apply(map, (i * 13) % 2500, add_to(i));
+		}
+		map.insert(NS::make_pair(5000, -1L));
+		map.insert(NS::make_pair(5000, -2L));
+		outfile << map.size() << " " << map.empty() << " " << count_sharded(map) << std::endl;
+		for (int k = 0; k < 2500; k += 41)
+		{
+			found = map_find_copy(map, k, value);
+			outfile << k << " " << found << " " << (found ? value : -1) << " "
+				<< map.count(k) << std::endl;
+		}
+		print_ordered(outfile, map);
+		outfile << map[91] << " " << map[6000] << " " << map.size() << std::endl;
+		map.clear();
+		outfile << map.size() << " " << map.empty() << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Sharded map, from several threads
+	{
+		typedef NS::SHARDED_MAP<int, long>	map_type;
+
+		map_type				map;
+		map_task<map_type>		tasks[6];
+		counter_task<map_type>	counters[4];
+		int						done = 0;
+		size_t					bad = 0;
+		long					sum = 0;
+		long					value;
+
+		// the writers come first: for std, the readers run once they are done
+		for (int i = 0; i < 6; i++)
+		{
+			tasks[i]._map = &map;
+			tasks[i]._done = &done;
+			tasks[i]._id = i;
+			tasks[i]._writers = 3;
+			tasks[i]._keys = 30000;
+			tasks[i]._reader = (i >= 3);
+		}
+		run_tasks(tasks, 6);
+		for (int i = 0; i < 6; i++)
+			bad += tasks[i]._bad;
+		for (int k = 0; k < 30000; k++)
+			sum += (map_find_copy(map, k, value) ? value : 0);
+		outfile << map.size() << " " << count_sharded(map) << " " << bad << " " << sum
+			<< " " << map.count(29999) << " " << map.count(29997) << std::endl;
+		// the updates of the same keys from several threads all count
+		map.clear();
+		for (int i = 0; i < 4; i++)
+		{
+			counters[i]._map = &map;
+			counters[i]._rounds = 200;
+			counters[i]._keys = 100;
+		}
+		run_tasks(counters, 4);
+		sum = 0;
+		bad = 0;
+		for (int k = 0; k < 100; k++)
+		{
+			sum += map[k];
+			bad += (map[k] != 800);
+		}
+		outfile << map.size() << " " << sum << " " << bad << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// RCU map, from a single thread
+	{
+		typedef NS::RCU_MAP<int, long>	map_type;
+
+		map_type	map;
+		long		value = 0;
+		bool		found;
+
+		for (int i = 0; i < 3000; i++)
+		{
+			map_store(map, (i * 7919) % 2000, static_cast<long>(i));
+			if (i % 3 == 0)
+				map.erase((i * 31) % 2000);
+		}
+		map.insert(NS::make_pair(5000, -1L));
+		map.insert(NS::make_pair(0, -2L));
+		outfile << map.size() << " " << map.empty() << std::endl;
+		for (int k = 0; k < 2000; k += 37)
+		{
+			found = map_find_copy(map, k, value);
+			outfile << k << " " << found << " " << (found ? value : -1) << " "
+				<< map.count(k) << std::endl;
+		}
+		// a published version does not follow the later writes
+		{
+			const published_type<map_type>::type	before = map_published(map);
+
+			map_update(map, batch_update(6000, 50));
+			map.erase(5000);
+			print_map(outfile, before);
+			outfile << before.size() << " " << before.count(5000) << " " << map.size()
+				<< " " << map.count(5000) << " " << map.count(6049) << std::endl;
+		}
+		print_map(outfile, map_published(map));
+		map.clear();
+		outfile << map.size() << " " << map.empty() << " " << map_find_copy(map, 6000, value)
+			<< " " << value << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// RCU map, from several threads
+	{
+		typedef NS::RCU_MAP<int, long>	map_type;
+
+		map_type			map;
+		rcu_task<map_type>	tasks[4];
+		int					done = 0;
+		size_t				bad = 0;
+		long				value = 0;
+
+		// the writer comes first: for std, the readers run once it is done
+		for (int i = 0; i < 4; i++)
+		{
+			tasks[i]._map = &map;
+			tasks[i]._done = &done;
+			tasks[i]._rounds = 300;
+			tasks[i]._keys = 200;
+			tasks[i]._reader = (i != 0);
+		}
+		run_tasks(tasks, 4);
+		for (int i = 0; i < 4; i++)
+			bad += tasks[i]._bad;
+		outfile << map.size() << " " << bad << " " << map_find_copy(map, 0, value) << " "
+			<< value << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Heterogeneous lookup
+	{
+		typedef NS::map<std::string, size_t, string_less>	map_type;
+
+		map_type		map;
+		const map_type&	cmap = map;
+		const char*		words[] = { "pear", "apple", "fig", "kiwi", "plum", "lime" };
+
+		for (size_t i = 0; i < 6; i++)
+			map.insert(NS::make_pair(std::string(words[i]), i));
+		outfile << map.find(LOOKUP_KEY("fig"))->second << std::endl;
+		outfile << (cmap.find(LOOKUP_KEY("grape")) == cmap.end()) << std::endl;
+		outfile << map.count(LOOKUP_KEY("kiwi")) << map.count(LOOKUP_KEY("melon")) << std::endl;
+		outfile << map.lower_bound(LOOKUP_KEY("grape"))->first << std::endl;
+		outfile << cmap.upper_bound(LOOKUP_KEY("lime"))->first << std::endl;
+		outfile << (map.upper_bound(LOOKUP_KEY("plum")) == map.end()) << std::endl;
+		outfile << map.equal_range(LOOKUP_KEY("pear")).first->first << " "
+			<< map.equal_range(LOOKUP_KEY("pear")).second->first << std::endl;
+		outfile << (cmap.equal_range(LOOKUP_KEY("cherry")).first
+			== cmap.equal_range(LOOKUP_KEY("cherry")).second) << std::endl;
+		outfile << map.erase(LOOKUP_KEY("apple")) << map.erase(LOOKUP_KEY("apple")) << std::endl;
+		print_map(outfile, map);
+	}
+
+	outfile << std::endl;
 
 	// Non member functions
 	{
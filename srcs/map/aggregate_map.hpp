@@ -0,0 +1,308 @@
+#ifndef AGGREGATE_MAP_HPP
+#define AGGREGATE_MAP_HPP
+
+#include <memory>
+#include <functional>
+#include <limits>
+
+#include "map.hpp"
+
+namespace ft {
+
+// monoids for aggregate_map: an associative combine with its identity,
+// over the values that lift makes out of the mapped values
+
+template <typename T>
+struct sum_monoid {
+
+	typedef T	value_type;
+
+	static value_type	identity(void)
+	{
+		return (value_type());
+	}
+
+	template <typename U>
+	static value_type	lift(const U& x)
+	{
+		return (x);
+	}
+
+	static value_type	combine(const value_type& x, const value_type& y)
+	{
+		return (x + y);
+	}
+};
+
+// min_monoid and max_monoid take their identity from numeric_limits: they
+// only take the arithmetic types, whose bounds it knows, and do not
+// compile with the others, for which it would make up a T()
+
+template <typename T>
+struct min_monoid {
+
+	typedef typename ft::enable_if<std::numeric_limits<T>::is_specialized, T>::type	value_type;
+
+	static value_type	identity(void)
+	{
+		return (std::numeric_limits<T>::max());
+	}
+
+	template <typename U>
+	static value_type	lift(const U& x)
+	{
+		return (x);
+	}
+
+	static value_type	combine(const value_type& x, const value_type& y)
+	{
+		return ((y < x) ? y : x);
+	}
+};
+
+template <typename T>
+struct max_monoid {
+
+	typedef typename ft::enable_if<std::numeric_limits<T>::is_specialized, T>::type	value_type;
+
+	// min() is the smallest positive value of the floating point types
+	static value_type	identity(void)
+	{
+		if (std::numeric_limits<T>::is_integer)
+			return (std::numeric_limits<T>::min());
+		return (-std::numeric_limits<T>::max());
+	}
+
+	template <typename U>
+	static value_type	lift(const U& x)
+	{
+		return (x);
+	}
+
+	static value_type	combine(const value_type& x, const value_type& y)
+	{
+		return ((x < y) ? y : x);
+	}
+};
+
+// node that also keeps the aggregate of the mapped values of its subtree
+template <typename Key, typename T, typename Monoid>
+struct rb_aggregate_node : public rb_node<Key, T> {
+
+	rb_aggregate_node(const Key& key, const T& val) :
+		rb_node<Key, T>(key, val),
+		_agg(Monoid::lift(val))
+		{ }
+
+	typename Monoid::value_type	_agg;
+};
+
+// augmentation policy maintaining the aggregate of every subtree, in key
+// order: the monoid does not have to be commutative
+template <typename Monoid>
+struct rb_aggregate_augment {
+
+	typedef typename Monoid::value_type	value_type;
+
+	enum { augmented = 1 };
+	enum { counted = 0 };
+
+	template <typename Key, typename T>
+	struct node {
+		typedef rb_aggregate_node<Key, T, Monoid>	type;
+	};
+
+	template <typename Node>
+	static value_type	aggregate(const rb_node_base* x)
+	{
+		if (x == NULL)
+			return (Monoid::identity());
+		return (static_cast<const Node*>(x)->_agg);
+	}
+
+	template <typename Node>
+	static void	update(Node* x)
+	{
+		x->_agg = Monoid::combine(Monoid::combine(aggregate<Node>(x->_left),
+			Monoid::lift(x->_key_val.second)), aggregate<Node>(x->_right));
+	}
+
+	template <typename Node>
+	static void	copy(Node* to, const Node* from)
+	{
+		to->_agg = from->_agg;
+	}
+
+	template <typename Node, typename Key, typename T>
+	static void	construct(Node* node, const Key& key, const T& val)
+	{
+		::new (static_cast<void*>(node)) Node(key, val);
+	}
+
+	// aggregate of the keys in [lo, hi) of the tree rooted in x: the
+	// first node of the range met on the way down splits it, then the
+	// subtrees hanging inside the range along both bounds are combined
+	template <typename Node, typename Compare, typename K>
+	static value_type	range(const rb_node_base* x, const K& lo, const K& hi, const Compare& comp)
+	{
+		value_type			left = Monoid::identity();
+		value_type			right = Monoid::identity();
+		const rb_node_base*	y;
+
+		while (x != NULL)
+		{
+			if (comp(_key<Node>(x), lo))
+				x = x->_right;
+			else if (!comp(_key<Node>(x), hi))
+				x = x->_left;
+			else
+				break ;
+		}
+		if (x == NULL)
+			return (Monoid::identity());
+		for (y = x->_left; y != NULL; )
+		{
+			if (comp(_key<Node>(y), lo))
+				y = y->_right;
+			else
+			{
+				left = Monoid::combine(Monoid::combine(_lift<Node>(y),
+					aggregate<Node>(y->_right)), left);
+				y = y->_left;
+			}
+		}
+		for (y = x->_right; y != NULL; )
+		{
+			if (!comp(_key<Node>(y), hi))
+				y = y->_left;
+			else
+			{
+				right = Monoid::combine(right, Monoid::combine(aggregate<Node>(y->_left),
+					_lift<Node>(y)));
+				y = y->_right;
+			}
+		}
+		return (Monoid::combine(Monoid::combine(left, _lift<Node>(x)), right));
+	}
+
+	template <typename Node>
+	static const typename Node::key_type&	_key(const rb_node_base* x)
+	{
+		return (static_cast<const Node*>(x)->_key_val.first);
+	}
+
+	template <typename Node>
+	static value_type	_lift(const rb_node_base* x)
+	{
+		return (Monoid::lift(static_cast<const Node*>(x)->_key_val.second));
+	}
+};
+
+// map that answers aggregate(lo, hi), the combination of the mapped values
+// of the keys in [lo, hi), in O(log n). the aggregates are kept up to date
+// by every modifier, but not through the references to the mapped values:
+// operator[] is not available, at only reads, and a value written through
+// an iterator must be followed by refresh(it)
+template <class Key, class T, class Monoid = sum_monoid<T>, class Compare = std::less<Key>,
+		class Allocator = std::allocator<pair<const Key, T> > >
+class aggregate_map : public map<Key, T, Compare, Allocator, rb_aggregate_augment<Monoid> > {
+
+	private:
+		typedef rb_aggregate_augment<Monoid>					_augment;
+		typedef map<Key, T, Compare, Allocator, _augment>		_base;
+		typedef typename _base::_tree_type::node_type			_node_type;
+
+	public:
+		typedef typename _base::key_type		key_type;
+		typedef typename _base::mapped_type		mapped_type;
+		typedef typename _base::iterator		iterator;
+		typedef typename _base::const_iterator	const_iterator;
+		typedef typename Monoid::value_type		aggregate_type;
+
+		// construct/copy/destroy
+
+		explicit aggregate_map(const Compare& comp = Compare(), const Allocator& alloc = Allocator()) :
+			_base(comp, alloc)
+			{ }
+
+		template <class InputIterator>
+		aggregate_map(InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator()) :
+			_base(first, last, comp, alloc)
+			{ }
+
+		aggregate_map(const aggregate_map& x) :
+			_base(x)
+			{ }
+
+		~aggregate_map() { }
+
+		aggregate_map&	operator=(const aggregate_map& x)
+		{
+			_base::operator=(x);
+			return (*this);
+		}
+
+		// from_unsorted of map, which would build a plain map
+
+		template <class InputIterator>
+		static aggregate_map	from_unsorted(InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator())
+		{
+			return (from_unsorted(sequential_execution(), first, last, comp, alloc));
+		}
+
+		template <class Execution, class InputIterator>
+		static aggregate_map	from_unsorted(const Execution& exec, InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator())
+		{
+			aggregate_map	ret(comp, alloc);
+
+			ret._tree_base.assign_unsorted(first, last, exec);
+			return (ret);
+		}
+
+		// element access
+
+		const mapped_type&	at(const key_type& x) const
+		{
+			return (_base::at(x));
+		}
+
+		// aggregates
+
+		// of the whole map
+		aggregate_type	aggregate(void) const
+		{
+			return (_augment::template aggregate<_node_type>(this->_tree_base.get_root()));
+		}
+
+		// of the keys in [lo, hi)
+		aggregate_type	aggregate(const key_type& lo, const key_type& hi) const
+		{
+			return (_augment::template range<_node_type>(this->_tree_base.get_root(),
+				lo, hi, this->_tree_base.key_comp()));
+		}
+
+		// to call after the mapped value of position was written in place
+		void	refresh(iterator position)
+		{
+			this->_tree_base.refresh(position);
+		}
+
+		aggregate_map	split(const key_type& x)
+		{
+			aggregate_map	upper;
+
+			this->_tree_base.split(x, upper._tree_base);
+			return (upper);
+		}
+
+	private:
+		// would hand out a reference the aggregates could not follow
+		mapped_type&	operator[](const key_type& x);
+};
+
+}
+
+#endif
@@ -0,0 +1,434 @@
+#ifndef CONCURRENT_MAP_HPP
+#define CONCURRENT_MAP_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <new>
+#include <functional>
+#include <cstddef>
+
+#include "../type_traits.hpp"
+#include "../pool_allocator.hpp"
+#include "map.hpp"
+
+namespace ft {
+
+// the lockless readers of concurrent_map copy keys and values out of
+// nodes that a writer may be changing: only trivially copyable types can
+// be copied that way
+template <typename Key, typename T>
+struct seqlock_readable {
+	enum { value = __has_trivial_copy(Key) && __has_trivial_copy(T)
+		&& __has_trivial_destructor(Key) && __has_trivial_destructor(T) };
+};
+
+// unsigned word of N bytes, which may alias any type
+template <size_t N>
+struct seqlock_word {
+	typedef size_t __attribute__((__may_alias__))			type;
+};
+
+template <>
+struct seqlock_word<1> {
+	typedef unsigned char __attribute__((__may_alias__))	type;
+};
+
+template <>
+struct seqlock_word<2> {
+	typedef unsigned short __attribute__((__may_alias__))	type;
+};
+
+template <>
+struct seqlock_word<4> {
+	typedef unsigned int __attribute__((__may_alias__))		type;
+};
+
+// copies of a trivially copyable U word by word, with atomic stores and
+// loads, the words being as wide as the alignment of U allows: a reader
+// copying a value being written gets a mix of old and new words, that
+// the sequence check then rejects, instead of a data race
+template <typename U>
+struct seqlock_copy {
+	typedef typename seqlock_word<(__alignof__(U) < sizeof(size_t))
+		? __alignof__(U) : sizeof(size_t)>::type	word;
+
+	enum { words = sizeof(U) / sizeof(word) };
+
+	// room for a copy, aligned as U
+	struct storage {
+		char	_bytes[sizeof(U)];
+
+		const U&	get(void) const
+		{
+			return (*reinterpret_cast<const U*>(_bytes));
+		}
+	} __attribute__((__aligned__(__alignof__(U))));
+
+	static void	store(U& to, const U& from)
+	{
+		word*		w = reinterpret_cast<word*>(__builtin_addressof(to));
+		const word*	r = reinterpret_cast<const word*>(__builtin_addressof(from));
+
+		for (size_t i = 0; i < words; i++)
+			__atomic_store_n(w + i, r[i], __ATOMIC_RELEASE);
+	}
+
+	static void	load(storage& to, const U& from)
+	{
+		word*		w = reinterpret_cast<word*>(to._bytes);
+		const word*	r = reinterpret_cast<const word*>(__builtin_addressof(from));
+
+		for (size_t i = 0; i < words; i++)
+			w[i] = __atomic_load_n(r + i, __ATOMIC_ACQUIRE);
+	}
+};
+
+// augmentation policy of concurrent_map: nothing is added, but when the
+// readers go without the lock, the nodes are built with atomic stores,
+// as the memory of a node may be recycled under a reader still in it
+struct rb_seqlock_augment {
+
+	enum { augmented = 0 };
+	enum { counted = 0 };
+
+	template <typename Key, typename T>
+	struct node {
+		typedef rb_node<Key, T>	type;
+	};
+
+	template <typename Node>
+	static void	update(Node*)
+	{ }
+
+	template <typename Node>
+	static void	copy(Node*, const Node*)
+	{ }
+
+	template <typename Node, typename Key, typename T>
+	static void	construct(Node* node, const Key& key, const T& val)
+	{
+		_construct(node, key, val, typename bool_type<seqlock_readable<Key, T>::value>::type());
+	}
+
+	template <typename Node, typename Key, typename T>
+	static void	_construct(Node* node, const Key& key, const T& val, true_type)
+	{
+		_store_link(node->_left, NULL);
+		_store_link(node->_right, NULL);
+		node->_p = NULL;
+		node->_color = black;
+		node->_is_null = not_null;
+		seqlock_copy<Key>::store(node->_key_val.first, key);
+		seqlock_copy<T>::store(node->_key_val.second, val);
+	}
+
+	template <typename Node, typename Key, typename T>
+	static void	_construct(Node* node, const Key& key, const T& val, false_type)
+	{
+		::new (static_cast<void*>(node)) Node(key, val);
+	}
+};
+
+// map shared between threads, for workloads dominated by lookups.
+// writers take the write side of a rwlock and make a sequence number odd
+// for the time of their change. when Key and T are trivially copyable, a
+// reader takes no lock at all: it walks the tree, copies what it found
+// and starts over if the sequence number moved meanwhile, falling back
+// to the read side of the lock after a few tries. other types are
+// always read under the lock.
+// the writers store the links, keys and values with release order and
+// the readers load them with acquire order, which on x86 are plain moves:
+// a reader that saw any store of a change then sees the sequence number
+// it made odd.
+// a lockless reader can walk into a node being erased, so the nodes come
+// from a pool_allocator pinned for the lifetime of the map: their memory
+// is recycled but never given back, and a reader at worst sees a key or
+// value that the sequence check rejects. Compare has to accept such keys,
+// as the comparisons of arithmetic types do.
+// values are handed out by copy, there are no iterators
+template <class Key, class T, class Compare = std::less<Key> >
+class concurrent_map : private map<Key, T, Compare, pool_allocator<pair<const Key, T> >,
+	rb_seqlock_augment> {
+
+	private:
+		typedef map<Key, T, Compare, pool_allocator<pair<const Key, T> >,
+			rb_seqlock_augment>								_base;
+		typedef typename _base::_tree_type					_tree_type;
+		typedef typename _tree_type::node_type				_node_type;
+		typedef typename _tree_type::node_allocator_type	_node_allocator;
+		typedef rb_node_base*								_base_ptr;
+
+	public:
+		typedef Key									key_type;
+		typedef T									mapped_type;
+		typedef typename _base::value_type			value_type;
+		typedef Compare								key_compare;
+		typedef typename _base::size_type			size_type;
+		typedef map<Key, T, Compare>				map_type;
+
+		// construct/destroy
+
+		explicit concurrent_map(const Compare& comp = Compare()) :
+			_base(comp),
+			_seq(0),
+			_count(0),
+			_pin_alloc(this->_tree_base.get_node_allocator()),
+			_pin(_pin_alloc.allocate(1))
+		{
+			pthread_rwlock_init(&_lock, NULL);
+		}
+
+		~concurrent_map()
+		{
+			_pin_alloc.deallocate(_pin, 1);
+			pthread_rwlock_destroy(&_lock);
+		}
+
+		// capacity
+
+		size_type	size(void) const
+		{
+			return (__atomic_load_n(&_count, __ATOMIC_RELAXED));
+		}
+
+		bool	empty(void) const
+		{
+			return (size() == 0);
+		}
+
+		// lookup
+
+		// copies the value of k to value, which is left alone if k is missing
+		bool	find(const key_type& k, mapped_type& value) const
+		{
+			return (_read(k, &value, _optimistic()));
+		}
+
+		size_type	count(const key_type& k) const
+		{
+			return (_read(k, NULL, _optimistic()));
+		}
+
+		// consistent copy of the whole map, made under the read lock
+		map_type	copy(void) const
+		{
+			_read_guard	guard(_lock);
+
+			return (map_type(_base::begin(), _base::end(), _base::key_comp()));
+		}
+
+		// modifiers
+
+		// a writer only makes the sequence odd once it knows it changes
+		// the tree, so that the readers do not retry for nothing
+
+		bool	insert(const value_type& x)
+		{
+			_write_guard	guard(_lock);
+
+			if (_base::count(x.first) != 0)
+				return (false);
+			_sequence	seq(_seq);
+			_base::insert(x);
+			_store_count(_count + 1);
+			return (true);
+		}
+
+		// true when k was inserted, false when its value was assigned
+		bool	insert_or_assign(const key_type& k, const mapped_type& obj)
+		{
+			_write_guard					guard(_lock);
+			typename _base::iterator		it = _base::find(k);
+			_sequence						seq(_seq);
+
+			if (it != _base::end())
+			{
+				_assign(it->second, obj, _optimistic());
+				return (false);
+			}
+			_base::insert(value_type(k, obj));
+			_store_count(_count + 1);
+			return (true);
+		}
+
+		size_type	erase(const key_type& k)
+		{
+			_write_guard	guard(_lock);
+
+			if (_base::count(k) == 0)
+				return (0);
+			_sequence	seq(_seq);
+			_base::erase(k);
+			_store_count(_count - 1);
+			return (1);
+		}
+
+		void	clear(void)
+		{
+			_write_guard	guard(_lock);
+			_sequence		seq(_seq);
+
+			_base::clear();
+			_store_count(0);
+		}
+
+		// observers
+
+		key_compare	key_comp(void) const
+		{
+			return (_base::key_comp());
+		}
+
+	private:
+		// lockless reads are tried that many times before taking the lock
+		enum { _optimistic_tries = 8 };
+		// a walk longer than that has followed links a writer was changing:
+		// a red black tree is never deeper than twice the log2 of its size
+		enum { _max_depth = 128 };
+
+		typedef typename bool_type<seqlock_readable<Key, T>::value>::type	_optimistic;
+
+		// holders of the two sides of the lock
+		struct _read_guard {
+			_read_guard(pthread_rwlock_t& lock) : _lock(lock)
+			{
+				pthread_rwlock_rdlock(&_lock);
+			}
+
+			~_read_guard()
+			{
+				pthread_rwlock_unlock(&_lock);
+			}
+
+			pthread_rwlock_t&	_lock;
+		};
+
+		struct _write_guard {
+			_write_guard(pthread_rwlock_t& lock) : _lock(lock)
+			{
+				pthread_rwlock_wrlock(&_lock);
+			}
+
+			~_write_guard()
+			{
+				pthread_rwlock_unlock(&_lock);
+			}
+
+			pthread_rwlock_t&	_lock;
+		};
+
+		// keeps the sequence number odd while it lives, under the write
+		// lock. the stores of the change come after the first store, with
+		// release order, so that they are not seen without it
+		struct _sequence {
+			_sequence(size_t& seq) : _seq(seq)
+			{
+				__atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELAXED);
+			}
+
+			~_sequence()
+			{
+				__atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELEASE);
+			}
+
+			size_t&	_seq;
+		};
+
+		void	_store_count(size_type count)
+		{
+			__atomic_store_n(&_count, count, __ATOMIC_RELAXED);
+		}
+
+		// the value of a key already there, which the lockless readers may
+		// be copying
+		static void	_assign(mapped_type& to, const mapped_type& from, true_type)
+		{
+			seqlock_copy<mapped_type>::store(to, from);
+		}
+
+		static void	_assign(mapped_type& to, const mapped_type& from, false_type)
+		{
+			to = from;
+		}
+
+		// lockless read: the key and the value are copied out of the node
+		// word by word, and only used once the sequence number was checked
+		bool	_read(const key_type& k, mapped_type* value, true_type) const
+		{
+			typename seqlock_copy<mapped_type>::storage	copy = {};
+			size_t										seq;
+			int											found;
+
+			for (size_t i = 0; i < _optimistic_tries; i++)
+			{
+				seq = __atomic_load_n(&_seq, __ATOMIC_ACQUIRE);
+				if (seq % 2 != 0)
+				{
+					sched_yield();
+					continue ;
+				}
+				found = _racy_find(k, copy);
+				if (found >= 0 && __atomic_load_n(&_seq, __ATOMIC_RELAXED) == seq)
+				{
+					if (found && value != NULL)
+						*value = copy.get();
+					return (found);
+				}
+			}
+			return (_read(k, value, false_type()));
+		}
+
+		bool	_read(const key_type& k, mapped_type* value, false_type) const
+		{
+			_read_guard						guard(_lock);
+			typename _base::const_iterator	it = _base::find(k);
+
+			if (it == _base::end())
+				return (false);
+			if (value != NULL)
+				*value = it->second;
+			return (true);
+		}
+
+		// 1 with the value of k copied to value, 0 when k is missing, and
+		// -1 when the walk went on for too long
+		int	_racy_find(const key_type& k, typename seqlock_copy<mapped_type>::storage& value) const
+		{
+			const key_compare							comp = _base::key_comp();
+			_base_ptr									x = this->_tree_base.get_root();
+			typename seqlock_copy<key_type>::storage	key;
+
+			for (size_t depth = 0; x != NULL; depth++)
+			{
+				if (depth == _max_depth)
+					return (-1);
+				seqlock_copy<key_type>::load(key, static_cast<_node_type*>(x)->_key_val.first);
+				if (comp(k, key.get()))
+					x = __atomic_load_n(&x->_left, __ATOMIC_ACQUIRE);
+				else if (comp(key.get(), k))
+					x = __atomic_load_n(&x->_right, __ATOMIC_ACQUIRE);
+				else
+				{
+					seqlock_copy<mapped_type>::load(value,
+						static_cast<_node_type*>(x)->_key_val.second);
+					return (1);
+				}
+			}
+			return (0);
+		}
+
+		// shared between threads: not copyable
+		concurrent_map(const concurrent_map&);
+		concurrent_map&	operator=(const concurrent_map&);
+
+		mutable pthread_rwlock_t	_lock;
+		size_t						_seq;
+		size_type					_count;
+		// one node held from the pool, so that it never gives its memory back
+		_node_allocator				_pin_alloc;
+		_node_type*					_pin;
+};
+
+}
+
+#endif
@@ -5,15 +5,19 @@
 #include <functional>
 
 #include "rb_tree.hpp"
+#include "node_handle.hpp"
 
 namespace ft {
 
+// Augment is an augmentation policy for the tree (see rb_no_augment),
+// used by the augmented maps that derive from map
 template <class Key, class T, class Compare = std::less<Key>,
-		class Allocator = std::allocator<pair<const Key, T> > >
+		class Allocator = std::allocator<pair<const Key, T> >,
+		class Augment = rb_no_augment>
 class map {
 
-	private:
-		typedef rb_tree<Key, T, Compare, Allocator>	_tree_type;
+	protected:
+		typedef rb_tree<Key, T, Compare, Allocator, Augment>	_tree_type;
 
 		_tree_type	_tree_base;
 
@@ -33,6 +37,9 @@ class map {
 		typedef typename Allocator::const_pointer	const_pointer;
 		typedef typename _tree_type::reverse_iterator	reverse_iterator;
 		typedef typename _tree_type::const_reverse_iterator	const_reverse_iterator;
+		typedef map_node_handle<Key, T, Allocator,
+			typename _tree_type::node_type>			node_type;
+		typedef map_insert_return<iterator, node_type>	insert_return_type;
 
 		class	value_compare
 			: public std::binary_function<value_type, value_type, bool> {
@@ -73,6 +80,33 @@ class map {
 			_tree_base = x._tree_base;
 			return (*this);
 		}
+
+		// bulk construction from pairs in any order: sorted, then built in
+		// O(n). as with the range constructor, the first of several
+		// equivalent keys is kept
+		template <class InputIterator>
+		static map	from_unsorted(InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator())
+		{
+			return (from_unsorted(sequential_execution(), first, last, comp, alloc));
+		}
+
+		// the same, with the sort run by exec: parallel_execution, from
+		// parallel.hpp, sorts on several threads. only the sort is spread
+		// over them: its last merge, the removal of the equivalent keys
+		// and the building of the tree each take one O(n) pass on the
+		// calling thread, which bounds the speedup. an exception thrown
+		// there by a comparison or a copy does not cross threads as it
+		// is: it comes out as std::bad_alloc, or as a std::runtime_error
+		template <class Execution, class InputIterator>
+		static map	from_unsorted(const Execution& exec, InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator())
+		{
+			map	ret(comp, alloc);
+
+			ret._tree_base.assign_unsorted(first, last, exec);
+			return (ret);
+		}
 		
 		allocator_type	get_allocator(void) const
 		{
@@ -142,11 +176,10 @@ class map {
 
 		// element access
 
+		// T() is only built when x is not in the map yet
 		T&	operator[](const key_type& x)
 		{
-			ft::pair<iterator, bool>	p = insert(ft::make_pair(x, T()));
-
-			return ((p.first)->second);
+			return (_tree_base.try_emplace(x).first->second);
 		}
 
 		T&	at(const key_type& x)
@@ -181,11 +214,60 @@ class map {
 		template <class InputIterator>
 			void	insert(InputIterator first, InputIterator last)
 		{
-			while (first != last)
-			{
-				_tree_base._insert_pair(*first);
-				++first;
-			}
+			_tree_base.insert_range(first, last);
+		}
+
+		// without variadic templates, the mapped value is built from (at
+		// most) one argument. it is only built if x is not in the map yet,
+		// directly into the new node
+
+		pair<iterator, bool>	try_emplace(const key_type& x)
+		{
+			return (_tree_base.try_emplace(x));
+		}
+
+		template <class M>
+		pair<iterator, bool>	try_emplace(const key_type& x, const M& obj)
+		{
+			return (_tree_base.try_emplace(x, obj));
+		}
+
+		iterator	try_emplace(iterator hint, const key_type& x)
+		{
+			return (_tree_base.try_emplace(hint, x));
+		}
+
+		template <class M>
+		iterator	try_emplace(iterator hint, const key_type& x, const M& obj)
+		{
+			return (_tree_base.try_emplace(hint, x, obj));
+		}
+
+		template <class M>
+		pair<iterator, bool>	insert_or_assign(const key_type& x, const M& obj)
+		{
+			return (_tree_base.insert_or_assign(x, obj));
+		}
+
+		template <class M>
+		iterator	insert_or_assign(iterator hint, const key_type& x, const M& obj)
+		{
+			return (_tree_base.insert_or_assign(hint, x, obj));
+		}
+
+		// the key is converted to key_type first, as it has to be compared,
+		// then emplace behaves as try_emplace
+
+		template <class K, class M>
+		pair<iterator, bool>	emplace(const K& k, const M& obj)
+		{
+			return (_tree_base.try_emplace(static_cast<const key_type&>(k), obj));
+		}
+
+		template <class K, class M>
+		iterator	emplace_hint(iterator hint, const K& k, const M& obj)
+		{
+			return (_tree_base.try_emplace(hint, static_cast<const key_type&>(k), obj));
 		}
 
 		void	erase(iterator position)
@@ -198,19 +280,150 @@ class map {
 			return (_tree_base.erase(x));
 		}
 
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, size_type>::type
+		erase(const K& x)
+		{
+			return (_tree_base.erase(x));
+		}
+
 		void	erase(iterator first, iterator last)
 		{
-			iterator	tmp;
+			_tree_base.erase(first, last);
+		}
+			
+		// node handles
+
+		node_type	extract(iterator position)
+		{
+			return (node_type(_tree_base.extract_node(position), _tree_base.get_node_allocator()));
+		}
+
+		node_type	extract(const key_type& x)
+		{
+			return (extract(find(x)));
+		}
+
+		// without rvalue references, nh is taken by const reference and
+		// emptied when its node is inserted, as if it had been moved from.
+		// a node from an unequal allocator is copied instead, then freed
+
+		insert_return_type	insert(const node_type& nh)
+		{
+			insert_return_type			ret;
+			ft::pair<iterator, bool>	p;
 
-			while (first != last)
+			if (nh.empty())
+			{
+				ret.position = end();
+				ret.inserted = false;
+				return (ret);
+			}
+			if (nh._alloc == _tree_base.get_node_allocator())
+				p = _tree_base.insert_node(nh._node);
+			else
+				p = _tree_base.try_emplace(nh.key(), nh.mapped());
+			ret.position = p.first;
+			ret.inserted = p.second;
+			if (!p.second)
+				ret.node = nh;
+			else
+				_consume(nh);
+			return (ret);
+		}
+
+		iterator	insert(iterator hint, const node_type& nh)
+		{
+			iterator	ret;
+			bool		inserted;
+
+			if (nh.empty())
+				return (end());
+			if (nh._alloc == _tree_base.get_node_allocator())
 			{
-				tmp = first;
-				++tmp;
-				_tree_base.erase(first);
-				first = tmp;
+				ret = _tree_base.insert_node(hint, nh._node);
+				inserted = (ret._node == nh._node);
 			}
+			else
+				ret = _tree_base.try_emplace(hint, nh.key(), nh.mapped(), &inserted);
+			if (inserted)
+				_consume(nh);
+			return (ret);
 		}
-			
+
+		void	merge(map& source)
+		{
+			_tree_base.merge(source._tree_base);
+		}
+
+		// split and join: O(log n), except that a split has to count the
+		// elements of its smaller side to keep the sizes, in O(min(k, n - k))
+		// more, unless the nodes count their subtrees, as in ranked_map
+
+		// the keys not lower than x are moved to the returned map. the
+		// keys are compared before anything moves: when the comparator
+		// throws, the map is left as it was
+		map	split(const key_type& x)
+		{
+			map	upper;
+
+			_tree_base.split(x, upper._tree_base);
+			return (upper);
+		}
+
+		// takes the elements of other, whose keys must all be lower or all
+		// be greater than the keys of the map. when they overlap, the maps
+		// are merged instead
+		void	join(map& other)
+		{
+			_tree_base.join(other._tree_base);
+		}
+
+		// set algebra on the keys, by splits and joins: O(m log(n / m + 1))
+		// for maps of m <= n elements. the elements of the map win over
+		// those of other with the same keys. given an exec, such as the
+		// parallel_execution of parallel.hpp, the independent parts are
+		// run as it runs them (with the exceptions of from_unsorted). when
+		// the comparator throws, the map is left empty, and so is other
+		// after unite
+
+		// takes the elements of other whose keys are missing from the map,
+		// and destroys the others: other is left empty
+		void	unite(map& other)
+		{
+			_tree_base.unite(other._tree_base, sequential_execution());
+		}
+
+		template <class Execution>
+		void	unite(const Execution& exec, map& other)
+		{
+			_tree_base.unite(other._tree_base, exec);
+		}
+
+		// erases the elements whose keys are missing from other
+		void	intersect(const map& other)
+		{
+			_tree_base.intersect(other._tree_base, sequential_execution());
+		}
+
+		template <class Execution>
+		void	intersect(const Execution& exec, const map& other)
+		{
+			_tree_base.intersect(other._tree_base, exec);
+		}
+
+		// erases the elements whose keys are in other
+		void	subtract(const map& other)
+		{
+			_tree_base.subtract(other._tree_base, sequential_execution());
+		}
+
+		template <class Execution>
+		void	subtract(const Execution& exec, const map& other)
+		{
+			_tree_base.subtract(other._tree_base, exec);
+		}
+
 		void	swap(map& other)
 		{
 			_tree_base.swap(other._tree_base);
@@ -226,12 +439,12 @@ class map {
 
 		key_compare	key_comp() const
 		{
-			return (key_compare());
+			return (_tree_base.key_comp());
 		}
 
 		value_compare	value_comp() const
 		{
-			return (value_compare(key_compare()));
+			return (value_compare(_tree_base.key_comp()));
 		}
 
 
@@ -247,6 +460,21 @@ class map {
 			return (_tree_base.find(x));
 		}
 
+		// batched find: writes an iterator (or end()) for each key of
+		// [first, last), with the descents interleaved to overlap their
+		// cache misses. meant for many independent keys on a large map
+		template <class ForwardIterator, class OutputIterator>
+		OutputIterator	find_many(ForwardIterator first, ForwardIterator last, OutputIterator out)
+		{
+			return (_tree_base.find_many(first, last, out));
+		}
+
+		template <class ForwardIterator, class OutputIterator>
+		OutputIterator	find_many(ForwardIterator first, ForwardIterator last, OutputIterator out) const
+		{
+			return (_tree_base.find_many(first, last, out));
+		}
+
 		size_type	count(const key_type& x) const
 		{
 			return (_tree_base.count(x));
@@ -284,62 +512,140 @@ class map {
 			return (_tree_base.equal_range(x));
 		}
 
-		template <typename K1, typename T1, typename C1, typename A1>
-		friend bool	operator==(const map<K1, T1, C1, A1>& x,
-				const map<K1, T1, C1, A1>& y);
+		// heterogeneous lookup, for comparators declaring is_transparent:
+		// x is compared with the keys as is, without building a key_type
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, iterator>::type
+		find(const K& x)
+		{
+			return (_tree_base.find(x));
+		}
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, const_iterator>::type
+		find(const K& x) const
+		{
+			return (_tree_base.find(x));
+		}
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, size_type>::type
+		count(const K& x) const
+		{
+			return (_tree_base.count(x));
+		}
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, iterator>::type
+		lower_bound(const K& x)
+		{
+			return (_tree_base.lower_bound(x));
+		}
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, const_iterator>::type
+		lower_bound(const K& x) const
+		{
+			return (_tree_base.lower_bound(x));
+		}
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, iterator>::type
+		upper_bound(const K& x)
+		{
+			return (_tree_base.upper_bound(x));
+		}
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, const_iterator>::type
+		upper_bound(const K& x) const
+		{
+			return (_tree_base.upper_bound(x));
+		}
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, ft::pair<iterator, iterator> >::type
+		equal_range(const K& x)
+		{
+			return (_tree_base.equal_range(x));
+		}
+
+		template <typename K>
+		typename ft::enable_if_transparent<Compare, K, pair<const_iterator, const_iterator> >::type
+		equal_range(const K& x) const
+		{
+			return (_tree_base.equal_range(x));
+		}
+
+	private:
+		// empties nh once its node was inserted: the node now belongs to the
+		// tree, or was copied and has to be freed
+		void	_consume(const node_type& nh)
+		{
+			node_type	taken(nh);
+
+			if (taken._alloc == _tree_base.get_node_allocator())
+				taken._take();
+		}
+
+	public:
+		template <typename K1, typename T1, typename C1, typename A1, typename G1>
+		friend bool	operator==(const map<K1, T1, C1, A1, G1>& x,
+				const map<K1, T1, C1, A1, G1>& y);
 
-		template <typename K1, typename T1, typename C1, typename A1>
-		friend bool	operator<(const map<K1, T1, C1, A1>& x,
-						const map<K1, T1, C1, A1>& y);
+		template <typename K1, typename T1, typename C1, typename A1, typename G1>
+		friend bool	operator<(const map<K1, T1, C1, A1, G1>& x,
+						const map<K1, T1, C1, A1, G1>& y);
 
 
 };
 
-template <class Key, class T, class Compare, class Allocator>
-bool	operator==(const map<Key, T, Compare, Allocator>& x,
-				const map<Key, T, Compare, Allocator>& y)
+template <class Key, class T, class Compare, class Allocator, class Augment>
+bool	operator==(const map<Key, T, Compare, Allocator, Augment>& x,
+				const map<Key, T, Compare, Allocator, Augment>& y)
 {
 	return (x._tree_base == y._tree_base);
 }
 
-template <class Key, class T, class Compare, class Allocator>
-bool	operator<(const map<Key, T, Compare, Allocator>& x,
-				const map<Key, T, Compare, Allocator>& y)
+template <class Key, class T, class Compare, class Allocator, class Augment>
+bool	operator<(const map<Key, T, Compare, Allocator, Augment>& x,
+				const map<Key, T, Compare, Allocator, Augment>& y)
 {
 	return (x._tree_base < y._tree_base);
 }
 
-template <class key, class t, class compare, class allocator>
-bool	operator!=(const map<key, t, compare, allocator>& x,
-				const map<key, t, compare, allocator>& y)
+template <class key, class t, class compare, class allocator, class augment>
+bool	operator!=(const map<key, t, compare, allocator, augment>& x,
+				const map<key, t, compare, allocator, augment>& y)
 {
 	return (!(x == y));
 }
 
-template <class key, class t, class compare, class allocator>
-bool	operator>(const map<key, t, compare, allocator>& x,
-				const map<key, t, compare, allocator>& y)
+template <class key, class t, class compare, class allocator, class augment>
+bool	operator>(const map<key, t, compare, allocator, augment>& x,
+				const map<key, t, compare, allocator, augment>& y)
 {
 	return (!(x < y) && !(x == y));
 }
 
-template <class key, class t, class compare, class allocator>
-bool	operator>=(const map<key, t, compare, allocator>& x,
-				const map<key, t, compare, allocator>& y)
+template <class key, class t, class compare, class allocator, class augment>
+bool	operator>=(const map<key, t, compare, allocator, augment>& x,
+				const map<key, t, compare, allocator, augment>& y)
 {
 	return (!(x < y));
 }
 
-template <class key, class t, class compare, class allocator>
-bool	operator<=(const map<key, t, compare, allocator>& x,
-				const map<key, t, compare, allocator>& y)
+template <class key, class t, class compare, class allocator, class augment>
+bool	operator<=(const map<key, t, compare, allocator, augment>& x,
+				const map<key, t, compare, allocator, augment>& y)
 {
 	return (!(x > y));
 }
 
-template <class Key, class T, class Compare, class Allocator>
-void	swap(map<Key, T, Compare, Allocator>& x,
-			map<Key, T, Compare, Allocator>& y)
+template <class Key, class T, class Compare, class Allocator, class Augment>
+void	swap(map<Key, T, Compare, Allocator, Augment>& x,
+			map<Key, T, Compare, Allocator, Augment>& y)
 {
 	x.swap(y);
 }
@@ -0,0 +1,125 @@
+#ifndef NODE_HANDLE_HPP
+#define NODE_HANDLE_HPP
+
+#include <algorithm>
+
+#include "rb_tree.hpp"
+
+namespace ft {
+
+template <class Key, class T, class Compare, class Allocator, class Augment>
+class map;
+
+// owning handle on a node extracted from a map, that can be inserted
+// into another map without allocating. c++98 has no move semantics:
+// as with std::auto_ptr, copying a handle takes the node away from the
+// source handle, which is left empty. a node still held by the handle
+// when it is destroyed is freed with the allocator of its map.
+// Node is the node type of the tree of the map
+template <typename Key, typename T, typename Allocator, typename Node = rb_node<Key, T> >
+class map_node_handle {
+
+	private:
+		typedef typename Allocator::template rebind<Node>::other	node_allocator;
+		typedef Node*	node_ptr;
+
+	public:
+		typedef Key			key_type;
+		typedef T			mapped_type;
+		typedef Allocator	allocator_type;
+
+		map_node_handle(void) :
+			_node(NULL),
+			_alloc()
+			{ }
+
+		map_node_handle(const map_node_handle& from) :
+			_node(from._take()),
+			_alloc(from._alloc)
+			{ }
+
+		~map_node_handle(void)
+		{
+			_release();
+		}
+
+		map_node_handle&	operator=(const map_node_handle& from)
+		{
+			if (this != &from)
+			{
+				_release();
+				_alloc = from._alloc;
+				_node = from._take();
+			}
+			return (*this);
+		}
+
+		bool	empty(void) const
+		{
+			return (_node == NULL);
+		}
+
+		key_type&	key(void) const
+		{
+			return (_node->_key_val.first);
+		}
+
+		mapped_type&	mapped(void) const
+		{
+			return (_node->_key_val.second);
+		}
+
+		allocator_type	get_allocator(void) const
+		{
+			return (allocator_type(_alloc));
+		}
+
+		void	swap(map_node_handle& other)
+		{
+			std::swap(_node, other._node);
+			std::swap(_alloc, other._alloc);
+		}
+
+	private:
+		template <class K1, class T1, class C1, class A1, class G1>
+		friend class	map;
+
+		map_node_handle(node_ptr node, const node_allocator& alloc) :
+			_node(node),
+			_alloc(alloc)
+			{ }
+
+		node_ptr	_take(void) const
+		{
+			node_ptr	ret = _node;
+
+			_node = NULL;
+			return (ret);
+		}
+
+		void	_release(void)
+		{
+			if (_node != NULL)
+			{
+				_alloc.destroy(_node);
+				_alloc.deallocate(_node, 1);
+				_node = NULL;
+			}
+		}
+
+		mutable node_ptr	_node;
+		node_allocator		_alloc;
+};
+
+// result of the insertion of a node handle: when the key was already in
+// the map, position points to it and node keeps the handle's node
+template <typename Iterator, typename NodeType>
+struct map_insert_return {
+	Iterator	position;
+	bool		inserted;
+	NodeType	node;
+};
+
+}
+
+#endif
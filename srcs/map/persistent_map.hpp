@@ -0,0 +1,991 @@
+#ifndef PERSISTENT_MAP_HPP
+#define PERSISTENT_MAP_HPP
+
+#include <memory>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <cstddef>
+
+#include "../algorithm.hpp"
+#include "../iterator/iterator_adaptors.hpp"
+#include "rb_tree.hpp"
+#include "pair.hpp"
+
+namespace ft {
+
+// node of a persistent_map: it has no parent link, since it can belong to
+// several versions at once. _refs counts the links (parents and roots of
+// versions) to the node, a node is only written in place while it is 1
+template <typename Key, typename T>
+struct persistent_node {
+
+	persistent_node(const Key& key, const T& val) :
+		_left(NULL),
+		_right(NULL),
+		_refs(1),
+		_color(red),
+		_key_val(key, val)
+		{ }
+
+	persistent_node*	_left;
+	persistent_node*	_right;
+	size_t				_refs;
+	unsigned char		_color;
+	ft::pair<Key, T>	_key_val;
+};
+
+// a node without parent link cannot be climbed from: the iterator keeps
+// its map and looks the neighbour up from the root, in O(log n)
+template <typename Key, typename T, typename Map>
+struct	persistent_map_iterator
+{
+	typedef const ft::pair<Key, T>	value_type;
+	typedef const value_type&		reference;
+	typedef const value_type*		pointer;
+	typedef std::bidirectional_iterator_tag	iterator_category;
+	typedef ptrdiff_t	difference_type;
+
+	typedef const persistent_node<Key, T>*	const_node_ptr;
+	typedef persistent_map_iterator<Key, T, Map>	self;
+
+	public:
+
+	// constructors/destructor
+
+	persistent_map_iterator() :
+		_map(NULL),
+		_node(NULL)
+		{ }
+
+	persistent_map_iterator(const Map* map, const_node_ptr node) :
+		_map(map),
+		_node(node)
+		{ }
+
+	// iterator requirements
+
+	reference	operator*(void) const
+	{
+		return (_node->_key_val);
+	}
+
+	self&	operator++(void)
+	{
+		_node = _map->_next(_node);
+		return (*this);
+	}
+
+	// input iterator requirements
+
+	pointer	operator->(void) const
+	{
+		return (&_node->_key_val);
+	}
+
+	self	operator++(int)
+	{
+		self	tmp = *this;
+		_node = _map->_next(_node);
+		return (tmp);
+	}
+
+	friend bool	operator==(const self& x, const self& y)
+	{
+		return (x._node == y._node);
+	}
+
+	friend bool	operator!=(const self& x, const self& y)
+	{
+		return (x._node != y._node);
+	}
+
+	// bidirectional iterator requirements
+
+	self&	operator--(void)
+	{
+		_node = _map->_prev(_node);
+		return (*this);
+	}
+
+	self	operator--(int)
+	{
+		self	tmp = *this;
+		_node = _map->_prev(_node);
+		return (tmp);
+	}
+
+	const Map*		_map;
+	const_node_ptr	_node;
+};
+
+// map whose copies share their nodes: snapshot() and the copy constructor
+// are O(1), and a write to one version copies only the nodes it changes,
+// O(log n) of them, that another version still links to. the elements
+// cannot be written through the iterators, all writes go through insert,
+// insert_or_assign and erase.
+// a version is not thread safe, but different versions can be read,
+// written and destroyed on different threads, as long as the allocator
+// can be used from all of them: the reference counts are atomic
+template <class Key, class T, class Compare = std::less<Key>,
+		class Allocator = std::allocator<pair<const Key, T> > >
+class persistent_map {
+
+	private:
+		typedef persistent_node<Key, T>	_node_type;
+		typedef _node_type*				_node_ptr;
+		typedef const _node_type*		_const_node_ptr;
+		typedef typename Allocator::template rebind<_node_type>::other	_node_allocator;
+
+	public:
+		typedef Key						key_type;
+		typedef T						mapped_type;
+		typedef pair<const Key, T>		value_type;
+		typedef Compare					key_compare;
+		typedef Allocator				allocator_type;
+		typedef value_type&				reference;
+		typedef const value_type&		const_reference;
+		typedef persistent_map_iterator<Key, T, persistent_map>	const_iterator;
+		typedef const_iterator			iterator;
+		typedef size_t					size_type;
+		typedef ptrdiff_t				difference_type;
+		typedef typename Allocator::pointer	pointer;
+		typedef typename Allocator::const_pointer	const_pointer;
+		typedef ft::reverse_iterator<const_iterator>	const_reverse_iterator;
+		typedef const_reverse_iterator	reverse_iterator;
+
+		// construct/copy/destroy
+
+		explicit persistent_map(const Compare& comp = Compare(), const Allocator& alloc = Allocator()) :
+			_root(NULL),
+			_size(0),
+			_spare(NULL),
+			_spare_count(0),
+			_comp(comp),
+			_alloc(alloc)
+			{ }
+
+		template <class InputIterator>
+		persistent_map(InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator()) :
+			_root(NULL),
+			_size(0),
+			_spare(NULL),
+			_spare_count(0),
+			_comp(comp),
+			_alloc(alloc)
+		{
+			try
+			{
+				insert(first, last);
+			}
+			catch (...)
+			{
+				_release(_root);
+				throw ;
+			}
+		}
+
+		// shares the nodes of x
+		persistent_map(const persistent_map& x) :
+			_root(_acquire(x._root)),
+			_size(x._size),
+			_spare(NULL),
+			_spare_count(0),
+			_comp(x._comp),
+			_alloc(x._alloc)
+			{ }
+
+		~persistent_map()
+		{
+			_release(_root);
+			_free_spares();
+		}
+
+		// the nodes of this version are let go with the allocator that
+		// made them, before the one of x is taken
+		persistent_map&	operator=(const persistent_map& x)
+		{
+			_node_ptr	root = _acquire(x._root);
+
+			_release(_root);
+			_free_spares();
+			_root = root;
+			_size = x._size;
+			_comp = x._comp;
+			_alloc = x._alloc;
+			return (*this);
+		}
+
+		// O(1) copy of the current version, that no later write to this
+		// map will change
+		persistent_map	snapshot(void) const
+		{
+			return (*this);
+		}
+
+		allocator_type	get_allocator(void) const
+		{
+			return (allocator_type(_alloc));
+		}
+
+		// iterators
+
+		const_iterator	begin(void) const
+		{
+			_const_node_ptr	x = _root;
+
+			while (x != NULL && x->_left != NULL)
+				x = x->_left;
+			return (const_iterator(this, x));
+		}
+
+		const_iterator	end(void) const
+		{
+			return (const_iterator(this, NULL));
+		}
+
+		const_reverse_iterator	rbegin(void) const
+		{
+			return (const_reverse_iterator(end()));
+		}
+
+		const_reverse_iterator	rend(void) const
+		{
+			return (const_reverse_iterator(begin()));
+		}
+
+		// capacity
+
+		bool	empty(void) const
+		{
+			return (_size == 0);
+		}
+
+		size_type	size(void) const
+		{
+			return (_size);
+		}
+
+		size_type	max_size(void) const
+		{
+			return (_alloc.max_size());
+		}
+
+		// element access
+
+		const mapped_type&	at(const key_type& x) const
+		{
+			_const_node_ptr	node = _find(x);
+
+			if (node == NULL)
+				throw std::out_of_range("ft::persistent_map::at");
+			return (node->_key_val.second);
+		}
+
+		// modifiers
+
+		// strong guarantee: the nodes on the path are copied top down, so
+		// the map stays whole if a copy throws, and are only relinked once
+		// the new node is in
+		ft::pair<iterator, bool>	insert(const value_type& x)
+		{
+			_const_node_ptr	found = _find(x.first);
+
+			if (found != NULL)
+				return (ft::make_pair(const_iterator(this, found), false));
+			return (ft::make_pair(const_iterator(this, _insert_new(x.first, x.second)), true));
+		}
+
+		iterator	insert(iterator, const value_type& x)
+		{
+			return (insert(x).first);
+		}
+
+		template <class InputIterator>
+		void	insert(InputIterator first, InputIterator last)
+		{
+			for (; first != last; ++first)
+				insert(*first);
+		}
+
+		// the value is written on this version's own copy of the node
+		ft::pair<iterator, bool>	insert_or_assign(const key_type& k, const mapped_type& obj)
+		{
+			_node_ptr	node;
+
+			if (_find(k) == NULL)
+				return (ft::make_pair(const_iterator(this, _insert_new(k, obj)), true));
+			node = _own_path(k);
+			node->_key_val.second = obj;
+			return (ft::make_pair(const_iterator(this, node), false));
+		}
+
+		// the nodes that erase may have to copy are reserved up front: if
+		// the copies of Key and T do not throw, neither does the erasure
+		// once it has started
+		size_type	erase(const key_type& x)
+		{
+			if (_find(x) == NULL)
+				return (0);
+			_reserve(_spares_needed());
+			_root = _erase_at(_root, x);
+			if (_is_red(_root))
+			{
+				_root = _own(_root);
+				_root->_color = black;
+			}
+			_size--;
+			return (1);
+		}
+
+		// the key is copied first, its node may be freed on the way
+		void	erase(iterator position)
+		{
+			key_type	k(position->first);
+
+			erase(k);
+		}
+
+		void	swap(persistent_map& other)
+		{
+			std::swap(_root, other._root);
+			std::swap(_size, other._size);
+			std::swap(_spare, other._spare);
+			std::swap(_spare_count, other._spare_count);
+			std::swap(_comp, other._comp);
+			std::swap(_alloc, other._alloc);
+		}
+
+		// only the nodes no other version links to are freed
+		void	clear(void)
+		{
+			_release(_root);
+			_root = NULL;
+			_size = 0;
+		}
+
+		// observers
+
+		key_compare	key_comp(void) const
+		{
+			return (_comp);
+		}
+
+		// operations
+
+		const_iterator	find(const key_type& x) const
+		{
+			return (const_iterator(this, _find(x)));
+		}
+
+		size_type	count(const key_type& x) const
+		{
+			return (_find(x) != NULL);
+		}
+
+		const_iterator	lower_bound(const key_type& x) const
+		{
+			_const_node_ptr	y = NULL;
+
+			for (_const_node_ptr node = _root; node != NULL; )
+			{
+				if (!_comp(node->_key_val.first, x))
+				{
+					y = node;
+					node = node->_left;
+				}
+				else
+					node = node->_right;
+			}
+			return (const_iterator(this, y));
+		}
+
+		const_iterator	upper_bound(const key_type& x) const
+		{
+			_const_node_ptr	y = NULL;
+
+			for (_const_node_ptr node = _root; node != NULL; )
+			{
+				if (_comp(x, node->_key_val.first))
+				{
+					y = node;
+					node = node->_left;
+				}
+				else
+					node = node->_right;
+			}
+			return (const_iterator(this, y));
+		}
+
+		ft::pair<const_iterator, const_iterator>	equal_range(const key_type& x) const
+		{
+			return (ft::make_pair(lower_bound(x), upper_bound(x)));
+		}
+
+		// true when both maps are versions that still share their root,
+		// which means they hold the same elements
+		bool	shares_root(const persistent_map& other) const
+		{
+			return (_root == other._root);
+		}
+
+	private:
+		friend struct	persistent_map_iterator<Key, T, persistent_map>;
+
+		_node_ptr		_root;
+		size_type		_size;
+		// raw nodes kept for erase (see _reserve), linked through
+		// their first word
+		_node_ptr		_spare;
+		size_type		_spare_count;
+		Compare			_comp;
+		_node_allocator	_alloc;
+
+		// at most that many nodes are copied per level of the tree by an
+		// erasure: the node on the path, the sibling and two of its
+		// children, and two more by the rebalancing below (see _fuse)
+		enum { _spares_per_level = 9 };
+
+		// lookups
+
+		_const_node_ptr	_find(const key_type& x) const
+		{
+			_const_node_ptr	node = _root;
+
+			while (node != NULL)
+			{
+				if (_comp(x, node->_key_val.first))
+					node = node->_left;
+				else if (_comp(node->_key_val.first, x))
+					node = node->_right;
+				else
+					return (node);
+			}
+			return (NULL);
+		}
+
+		// in order neighbours: below x when it has the child on that
+		// side, else looked up from the root
+		_const_node_ptr	_next(_const_node_ptr x) const
+		{
+			_const_node_ptr	y = NULL;
+
+			if (x->_right != NULL)
+			{
+				for (y = x->_right; y->_left != NULL; )
+					y = y->_left;
+				return (y);
+			}
+			for (_const_node_ptr node = _root; node != NULL; )
+			{
+				if (_comp(x->_key_val.first, node->_key_val.first))
+				{
+					y = node;
+					node = node->_left;
+				}
+				else
+					node = node->_right;
+			}
+			return (y);
+		}
+
+		// the predecessor of end() is the last element
+		_const_node_ptr	_prev(_const_node_ptr x) const
+		{
+			_const_node_ptr	y = NULL;
+
+			if (x != NULL && x->_left != NULL)
+			{
+				for (y = x->_left; y->_right != NULL; )
+					y = y->_right;
+				return (y);
+			}
+			for (_const_node_ptr node = _root; node != NULL; )
+			{
+				if (x == NULL || _comp(node->_key_val.first, x->_key_val.first))
+				{
+					y = node;
+					node = node->_right;
+				}
+				else
+					node = node->_left;
+			}
+			return (y);
+		}
+
+		// reference counting
+
+		static _node_ptr	_acquire(_node_ptr x)
+		{
+			if (x != NULL)
+				__atomic_add_fetch(&x->_refs, 1, __ATOMIC_RELAXED);
+			return (x);
+		}
+
+		static bool	_is_shared(_const_node_ptr x)
+		{
+			return (__atomic_load_n(&x->_refs, __ATOMIC_ACQUIRE) != 1);
+		}
+
+		// drops one link to x, and frees x once it was the last one
+		void	_release(_node_ptr x)
+		{
+			while (x != NULL && __atomic_sub_fetch(&x->_refs, 1, __ATOMIC_ACQ_REL) == 0)
+			{
+				_node_ptr	right = x->_right;
+
+				_release(x->_left);
+				_delete_node(x);
+				x = right;
+			}
+		}
+
+		// takes over the link x and returns a node this version is the only
+		// one to link to: x itself, or a copy of x sharing its children
+		_node_ptr	_own(_node_ptr x)
+		{
+			_node_ptr	copy;
+
+			if (x == NULL || !_is_shared(x))
+				return (x);
+			copy = _new_node(x->_key_val.first, x->_key_val.second);
+			copy->_color = x->_color;
+			copy->_left = _acquire(x->_left);
+			copy->_right = _acquire(x->_right);
+			_release(x);
+			return (copy);
+		}
+
+		// owns the nodes from the root down to the one of key k, which is
+		// in the map. each link is switched to the copy as soon as it is
+		// made, so the map stays whole if a copy throws
+		_node_ptr	_own_path(const key_type& k)
+		{
+			_node_ptr*	link = &_root;
+
+			while (true)
+			{
+				*link = _own(*link);
+				if (_comp(k, (*link)->_key_val.first))
+					link = &(*link)->_left;
+				else if (_comp((*link)->_key_val.first, k))
+					link = &(*link)->_right;
+				else
+					return (*link);
+			}
+		}
+
+		// k is not in the map
+		_node_ptr	_insert_new(const key_type& k, const mapped_type& obj)
+		{
+			_node_ptr	node = _new_node(k, obj);
+
+			try
+			{
+				_insert_at(_root, node);
+			}
+			catch (...)
+			{
+				_delete_node(node);
+				throw ;
+			}
+			_root->_color = black;
+			_size++;
+			return (node);
+		}
+
+		// node memory
+
+		_node_ptr	_new_node(const key_type& key, const mapped_type& val)
+		{
+			_node_ptr	node;
+
+			if (_spare != NULL)
+			{
+				node = _spare;
+				_spare = *reinterpret_cast<_node_ptr*>(node);
+				_spare_count--;
+			}
+			else
+				node = _alloc.allocate(1);
+			try
+			{
+				::new (static_cast<void*>(__builtin_addressof(*node))) _node_type(key, val);
+			}
+			catch (...)
+			{
+				_alloc.deallocate(node, 1);
+				throw ;
+			}
+			return (node);
+		}
+
+		void	_delete_node(_node_ptr x)
+		{
+			_alloc.destroy(__builtin_addressof(*x));
+			_alloc.deallocate(__builtin_addressof(*x), 1);
+		}
+
+		// makes sure n raw nodes are at hand, so that the copies made by
+		// erase cannot fail to allocate once the tree is being changed
+		void	_reserve(size_type n)
+		{
+			while (_spare_count < n)
+			{
+				_node_ptr	node = _alloc.allocate(1);
+
+				*reinterpret_cast<_node_ptr*>(node) = _spare;
+				_spare = node;
+				_spare_count++;
+			}
+		}
+
+		void	_free_spares(void)
+		{
+			while (_spare != NULL)
+			{
+				_node_ptr	node = _spare;
+
+				_spare = *reinterpret_cast<_node_ptr*>(node);
+				_alloc.deallocate(node, 1);
+			}
+			_spare_count = 0;
+		}
+
+		// the height of the tree is at most twice its black height, plus one
+		size_type	_spares_needed(void) const
+		{
+			size_type	black_height = 0;
+
+			for (_const_node_ptr x = _root; x != NULL; x = x->_left)
+				black_height += (x->_color == black);
+			return (_spares_per_level * (2 * black_height + 2));
+		}
+
+		// rebalancing, after Kahrs' functional red black trees. every
+		// function takes over the links it is given and returns the link
+		// to the subtree it built. the nodes whose links or color change
+		// are owned first
+
+		static bool	_is_red(_const_node_ptr x)
+		{
+			return (x != NULL && x->_color == red);
+		}
+
+		static bool	_is_black(_const_node_ptr x)
+		{
+			return (x != NULL && x->_color == black);
+		}
+
+		static _node_ptr	_link(_node_ptr left, _node_ptr x, _node_ptr right, rb_tree_color color)
+		{
+			x->_left = left;
+			x->_right = right;
+			x->_color = color;
+			return (x);
+		}
+
+		// inserts node below link. the red red violations only ever happen
+		// on the path, where every node is owned already
+		void	_insert_at(_node_ptr& link, _node_ptr node)
+		{
+			_node_ptr	x;
+
+			if (link == NULL)
+			{
+				link = node;
+				return ;
+			}
+			link = _own(link);
+			x = link;
+			if (_comp(node->_key_val.first, x->_key_val.first))
+				_insert_at(x->_left, node);
+			else
+				_insert_at(x->_right, node);
+			if (x->_color == black)
+				link = _balance_path(x);
+		}
+
+		// okasaki's balance of a black node z with a red child that has a
+		// red child: the three become a red node with two black children
+		static _node_ptr	_balance_path(_node_ptr z)
+		{
+			_node_ptr	x;
+			_node_ptr	y;
+
+			if (_is_red(z->_left) && _is_red(z->_left->_left))
+			{
+				y = z->_left;
+				x = y->_left;
+				z->_left = y->_right;
+				y->_right = z;
+			}
+			else if (_is_red(z->_left) && _is_red(z->_left->_right))
+			{
+				x = z->_left;
+				y = x->_right;
+				x->_right = y->_left;
+				z->_left = y->_right;
+				y->_left = x;
+				y->_right = z;
+			}
+			else if (_is_red(z->_right) && _is_red(z->_right->_left))
+			{
+				x = z;
+				z = x->_right;
+				y = z->_left;
+				x->_right = y->_left;
+				z->_left = y->_right;
+				y->_left = x;
+				y->_right = z;
+			}
+			else if (_is_red(z->_right) && _is_red(z->_right->_right))
+			{
+				x = z;
+				y = x->_right;
+				z = y->_right;
+				x->_right = y->_left;
+				y->_left = x;
+			}
+			else
+				return (z);
+			y->_left->_color = black;
+			y->_right->_color = black;
+			y->_color = red;
+			return (y);
+		}
+
+		// the black node x over a and b, with a red red violation below
+		// either side fixed, and two red children turned black
+		_node_ptr	_balance(_node_ptr a, _node_ptr x, _node_ptr b)
+		{
+			_node_ptr	y;
+			_node_ptr	left;
+			_node_ptr	right;
+
+			if (_is_red(a) && _is_red(b))
+			{
+				a = _own(a);
+				b = _own(b);
+				a->_color = black;
+				b->_color = black;
+				return (_link(a, x, b, red));
+			}
+			if (_is_red(a) && _is_red(a->_left))
+			{
+				a = _own(a);
+				y = _own(a->_left);
+				right = a->_right;
+				y->_color = black;
+				_link(right, x, b, black);
+				return (_link(y, a, x, red));
+			}
+			if (_is_red(a) && _is_red(a->_right))
+			{
+				a = _own(a);
+				y = _own(a->_right);
+				left = y->_left;
+				right = y->_right;
+				_link(a->_left, a, left, black);
+				_link(right, x, b, black);
+				return (_link(a, y, x, red));
+			}
+			if (_is_red(b) && _is_red(b->_right))
+			{
+				b = _own(b);
+				y = _own(b->_right);
+				left = b->_left;
+				y->_color = black;
+				_link(a, x, left, black);
+				return (_link(x, b, y, red));
+			}
+			if (_is_red(b) && _is_red(b->_left))
+			{
+				b = _own(b);
+				y = _own(b->_left);
+				left = y->_left;
+				right = y->_right;
+				_link(a, x, left, black);
+				_link(right, b, b->_right, black);
+				return (_link(x, y, b, red));
+			}
+			return (_link(a, x, b, black));
+		}
+
+		// x over left and right, where left is one black level short
+		_node_ptr	_balance_left(_node_ptr left, _node_ptr x, _node_ptr right)
+		{
+			_node_ptr	y;
+			_node_ptr	z;
+			_node_ptr	a;
+			_node_ptr	b;
+
+			if (_is_red(left))
+			{
+				left = _own(left);
+				left->_color = black;
+				return (_link(left, x, right, red));
+			}
+			if (_is_black(right))
+			{
+				right = _own(right);
+				right->_color = red;
+				return (_balance(left, x, right));
+			}
+			// right is red, its left child black
+			right = _own(right);
+			y = _own(right->_left);
+			z = _own(right->_right);
+			a = y->_left;
+			b = y->_right;
+			z->_color = red;
+			_link(left, x, a, black);
+			return (_link(x, y, _balance(b, right, z), red));
+		}
+
+		// x over left and right, where right is one black level short
+		_node_ptr	_balance_right(_node_ptr left, _node_ptr x, _node_ptr right)
+		{
+			_node_ptr	y;
+			_node_ptr	z;
+			_node_ptr	b;
+			_node_ptr	c;
+
+			if (_is_red(right))
+			{
+				right = _own(right);
+				right->_color = black;
+				return (_link(left, x, right, red));
+			}
+			if (_is_black(left))
+			{
+				left = _own(left);
+				left->_color = red;
+				return (_balance(left, x, right));
+			}
+			// left is red, its right child black
+			left = _own(left);
+			y = _own(left->_right);
+			z = _own(left->_left);
+			b = y->_left;
+			c = y->_right;
+			z->_color = red;
+			_link(c, x, right, black);
+			return (_link(_balance(z, left, b), y, x, red));
+		}
+
+		// joins the subtrees of an erased node, every key of a lower
+		// than every key of b
+		_node_ptr	_fuse(_node_ptr a, _node_ptr b)
+		{
+			_node_ptr	s;
+			_node_ptr	left;
+			_node_ptr	right;
+
+			if (a == NULL)
+				return (b);
+			if (b == NULL)
+				return (a);
+			if (_is_red(a) != _is_red(b))
+			{
+				if (_is_red(b))
+				{
+					b = _own(b);
+					left = _fuse(a, b->_left);
+					return (_link(left, b, b->_right, red));
+				}
+				a = _own(a);
+				right = _fuse(a->_right, b);
+				return (_link(a->_left, a, right, red));
+			}
+			a = _own(a);
+			b = _own(b);
+			s = _fuse(a->_right, b->_left);
+			if (_is_red(s))
+			{
+				rb_tree_color	color = static_cast<rb_tree_color>(a->_color);
+
+				s = _own(s);
+				left = s->_left;
+				right = s->_right;
+				_link(a->_left, a, left, color);
+				_link(right, b, b->_right, color);
+				return (_link(a, s, b, red));
+			}
+			if (a->_color == red)
+			{
+				_link(s, b, b->_right, red);
+				return (_link(a->_left, a, b, red));
+			}
+			_link(s, b, b->_right, black);
+			return (_balance_left(a->_left, a, b));
+		}
+
+		// erases k, which is below t: removing a black node leaves the
+		// returned subtree one black level short, which the callers fix
+		_node_ptr	_erase_at(_node_ptr t, const key_type& k)
+		{
+			_node_ptr	left;
+			_node_ptr	right;
+
+			if (_comp(k, t->_key_val.first))
+			{
+				bool	short_side = _is_black(t->_left);
+
+				t = _own(t);
+				left = _erase_at(t->_left, k);
+				if (short_side)
+					return (_balance_left(left, t, t->_right));
+				return (_link(left, t, t->_right, red));
+			}
+			if (_comp(t->_key_val.first, k))
+			{
+				bool	short_side = _is_black(t->_right);
+
+				t = _own(t);
+				right = _erase_at(t->_right, k);
+				if (short_side)
+					return (_balance_right(t->_left, t, right));
+				return (_link(t->_left, t, right, red));
+			}
+			left = t->_left;
+			right = t->_right;
+			if (_is_shared(t))
+			{
+				_acquire(left);
+				_acquire(right);
+				_release(t);
+			}
+			else
+				_delete_node(t);
+			return (_fuse(left, right));
+		}
+};
+
+template <class Key, class T, class Compare, class Allocator>
+bool	operator==(const persistent_map<Key, T, Compare, Allocator>& x,
+				const persistent_map<Key, T, Compare, Allocator>& y)
+{
+	if (x.size() != y.size())
+		return (false);
+	return (x.shares_root(y) || ft::equal(x.begin(), x.end(), y.begin()));
+}
+
+template <class Key, class T, class Compare, class Allocator>
+bool	operator!=(const persistent_map<Key, T, Compare, Allocator>& x,
+				const persistent_map<Key, T, Compare, Allocator>& y)
+{
+	return (!(x == y));
+}
+
+template <class Key, class T, class Compare, class Allocator>
+void	swap(persistent_map<Key, T, Compare, Allocator>& x,
+			persistent_map<Key, T, Compare, Allocator>& y)
+{
+	x.swap(y);
+}
+
+} // namespace ft
+
+#endif
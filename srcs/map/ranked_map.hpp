@@ -0,0 +1,166 @@
+#ifndef RANKED_MAP_HPP
+#define RANKED_MAP_HPP
+
+#include <memory>
+#include <functional>
+#include <cstddef>
+
+#include "map.hpp"
+
+namespace ft {
+
+// node that also counts the nodes of its subtree, itself included
+template <typename Key, typename T>
+struct rb_counted_node : public rb_node<Key, T> {
+
+	rb_counted_node(const Key& key, const T& val) :
+		rb_node<Key, T>(key, val),
+		_count(1)
+		{ }
+
+	size_t	_count;
+};
+
+// augmentation policy maintaining the subtree sizes,
+// which turns the tree into an order statistic tree
+struct rb_rank_augment {
+
+	enum { augmented = 1 };
+	enum { counted = 1 };
+
+	template <typename Key, typename T>
+	struct node {
+		typedef rb_counted_node<Key, T>	type;
+	};
+
+	template <typename Node>
+	static size_t	count(const rb_node_base* x)
+	{
+		if (x == NULL)
+			return (0);
+		return (static_cast<const Node*>(x)->_count);
+	}
+
+	template <typename Node>
+	static void	update(Node* x)
+	{
+		x->_count = 1 + count<Node>(x->_left) + count<Node>(x->_right);
+	}
+
+	template <typename Node>
+	static void	copy(Node* to, const Node* from)
+	{
+		to->_count = from->_count;
+	}
+
+	template <typename Node, typename Key, typename T>
+	static void	construct(Node* node, const Key& key, const T& val)
+	{
+		::new (static_cast<void*>(node)) Node(key, val);
+	}
+};
+
+// map whose elements can be reached by rank: nth, rank, index_of and
+// distance are in O(log n), paid for by one more word per node and
+// by the upkeep of the subtree sizes on every insertion and erasure
+template <class Key, class T, class Compare = std::less<Key>,
+		class Allocator = std::allocator<pair<const Key, T> > >
+class ranked_map : public map<Key, T, Compare, Allocator, rb_rank_augment> {
+
+	private:
+		typedef map<Key, T, Compare, Allocator, rb_rank_augment>	_base;
+
+	public:
+		typedef typename _base::key_type		key_type;
+		typedef typename _base::iterator		iterator;
+		typedef typename _base::const_iterator	const_iterator;
+		typedef typename _base::size_type		size_type;
+		typedef typename _base::difference_type	difference_type;
+
+		// construct/copy/destroy
+
+		explicit ranked_map(const Compare& comp = Compare(), const Allocator& alloc = Allocator()) :
+			_base(comp, alloc)
+			{ }
+
+		template <class InputIterator>
+		ranked_map(InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator()) :
+			_base(first, last, comp, alloc)
+			{ }
+
+		ranked_map(const ranked_map& x) :
+			_base(x)
+			{ }
+
+		~ranked_map() { }
+
+		ranked_map&	operator=(const ranked_map& x)
+		{
+			_base::operator=(x);
+			return (*this);
+		}
+
+		// from_unsorted of map, which would build a plain map
+
+		template <class InputIterator>
+		static ranked_map	from_unsorted(InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator())
+		{
+			return (from_unsorted(sequential_execution(), first, last, comp, alloc));
+		}
+
+		template <class Execution, class InputIterator>
+		static ranked_map	from_unsorted(const Execution& exec, InputIterator first, InputIterator last,
+			const Compare& comp = Compare(), const Allocator& alloc = Allocator())
+		{
+			ranked_map	ret(comp, alloc);
+
+			ret._tree_base.assign_unsorted(first, last, exec);
+			return (ret);
+		}
+
+		// order statistics
+
+		// element of rank k (the first one has rank 0), or end()
+		iterator	nth(size_type k)
+		{
+			return (this->_tree_base.nth(k));
+		}
+
+		const_iterator	nth(size_type k) const
+		{
+			return (this->_tree_base.nth(k));
+		}
+
+		// number of keys lower than x
+		size_type	rank(const key_type& x) const
+		{
+			return (this->_tree_base.rank(x));
+		}
+
+		// rank of the element at position, size() for end()
+		size_type	index_of(const_iterator position) const
+		{
+			return (this->_tree_base.index_of(position));
+		}
+
+		// ft::distance walks from first to last, this climbs to the root twice
+		difference_type	distance(const_iterator first, const_iterator last) const
+		{
+			return (static_cast<difference_type>(index_of(last))
+				- static_cast<difference_type>(index_of(first)));
+		}
+
+		ranked_map	split(const key_type& x)
+		{
+			ranked_map	upper;
+
+			this->_tree_base.split(x, upper._tree_base);
+			return (upper);
+		}
+};
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define RB_TREE_HPP
 
 #include <memory>
+#include <new>
 #include <iostream>
 #include <stdexcept>
 #include <cstddef>
@@ -9,7 +10,9 @@
 
 #include "../alloc_help.hpp"
 #include "../algorithm.hpp"
+#include "../type_traits.hpp"
 #include "../iterator/iterator_adaptors.hpp"
+#include "../vector/vector.hpp"
 #include "pair.hpp"
 
 namespace ft {
@@ -17,55 +20,120 @@ namespace ft {
 enum rb_tree_color { red = false, black = true };
 enum null_marker { not_null = false, null = true };
 
-// node struct used as base type for the tree
-template <typename Key, typename T>
-struct rb_node {
+// links and flags shared by every node, including the null node.
+// the tree algorithms only ever touch this part of a node.
+// a missing child is a NULL link, the null node only serves as
+// the end() node and as the parent of the root
+struct rb_node_base {
 
-	typedef rb_node*	node_ptr;
+	typedef rb_node_base*		base_ptr;
+	typedef const rb_node_base*	const_base_ptr;
 
-	// only used for initializing the null node
-	rb_node() :
-		_color(),
-		_is_null(),
-		_key(Key()),
-		_val(T()),
+	rb_node_base() :
 		_left(NULL),
 		_right(NULL),
-		_p(NULL)
-		{ }
-	
-	rb_node(const Key& key, const T& val, node_ptr null_node) :
+		_p(NULL),
 		_color(black),
-		_is_null(not_null),
-		_key(key),
-		_val(val),
-		_left(null_node),
-		_right(null_node),
-		_p(null_node),
+		_is_null(not_null)
+		{ }
+
+	base_ptr		_left;
+	base_ptr		_right;
+	base_ptr		_p;
+	// rb_tree_color and null_marker, stored on a byte each so that
+	// both flags fit in the padding after the links
+	unsigned char	_color;
+	unsigned char	_is_null;
+};
+
+// node struct used as base type for the tree: the links and flags
+// followed by the key/value pair, stored only once
+template <typename Key, typename T>
+struct rb_node : public rb_node_base {
+
+	typedef Key			key_type;
+	typedef T			mapped_type;
+	typedef rb_node*	node_ptr;
+
+	rb_node(const Key& key, const T& val) :
+		rb_node_base(),
 		_key_val(key, val)
 		{ }
 	
 	rb_node(const rb_node& from) :
-		_color(from._color),
-		_is_null(from._is_null),
-		_key(from._key),
-		_val(from._val),
-		_left(from._left),
-		_right(from._right),
-		_p(from._p),
+		rb_node_base(from),
 		_key_val(from._key_val)
 		{ }
 	
-	rb_tree_color	_color;
-	null_marker		_is_null;
-	Key				_key;
-	T				_val;
-	node_ptr		_left;
-	node_ptr		_right;
-	node_ptr		_p;
 	ft::pair<Key, T>	_key_val;
 };
 
+inline bool	_is_null_node(const rb_node_base* x)
+{
+	return (x->_is_null == null);
+}
+
+// store of a child link or of the root, with release order: the lockless
+// readers of concurrent_map load the links with acquire order while a
+// writer changes them. on x86 this is still a plain store
+inline void	_store_link(rb_node_base*& link, rb_node_base* x)
+{
+	__atomic_store_n(&link, x, __ATOMIC_RELEASE);
+}
+
+inline rb_node_base*	_tree_minimum(rb_node_base* x)
+{
+	while (x->_left)
+		x = x->_left;
+	return (x);
+}
+
+inline rb_node_base*	_tree_maximum(rb_node_base* x)
+{
+	while (x->_right)
+		x = x->_right;
+	return (x);
+}
+
+// the climb stops on the null node, which is the parent of the root
+inline rb_node_base*	_rb_tree_successor(rb_node_base* x)
+{
+	if (x->_right)
+		return (_tree_minimum(x->_right));
+	rb_node_base*	y = x->_p;
+	while (!_is_null_node(y) && x == y->_right)
+	{
+		x = y;
+		y = y->_p;
+	}
+	return (y);
+}
+
+inline const rb_node_base*	_rb_tree_successor(const rb_node_base* x)
+{
+	return (_rb_tree_successor(const_cast<rb_node_base*>(x)));
+}
+
+// the null node links to the rightmost node through _left,
+// so the predecessor of end() is the last element
+inline rb_node_base*	_rb_tree_predecessor(rb_node_base* x)
+{
+	if (x->_left)
+		return (_tree_maximum(x->_left));
+	rb_node_base*	y = x->_p;
+	while (!_is_null_node(y) && x == y->_left)
+	{
+		x = y;
+		y = y->_p;
+	}
+	return (y);
+}
+
+inline const rb_node_base*	_rb_tree_predecessor(const rb_node_base* x)
+{
+	return (_rb_tree_predecessor(const_cast<rb_node_base*>(x)));
+}
+
 template <typename Key, typename T>
 struct	rb_tree_iterator
 {
@@ -75,6 +143,7 @@ struct	rb_tree_iterator
 	typedef std::bidirectional_iterator_tag	iterator_category;
 	typedef ptrdiff_t	difference_type;
 
+	typedef rb_node_base*		base_ptr;
 	typedef	rb_node<Key, T>*	node_ptr;
 	typedef rb_tree_iterator<Key, T>	self;
 
@@ -86,7 +155,7 @@ struct	rb_tree_iterator
 		_node()
 		{ }
 
-	rb_tree_iterator(node_ptr node) :
+	rb_tree_iterator(base_ptr node) :
 		_node(node)
 		{ }
 	
@@ -107,7 +176,7 @@ struct	rb_tree_iterator
 
 	reference	operator*(void) const
 	{
-		return (_node->_key_val);
+		return (static_cast<node_ptr>(_node)->_key_val);
 	}
 
 	self&	operator++(void)
@@ -120,7 +189,7 @@ struct	rb_tree_iterator
 
 	pointer	operator->(void) const
 	{
-		return (&_node->_key_val);
+		return (&static_cast<node_ptr>(_node)->_key_val);
 	}
 
 	self	operator++(int)
@@ -155,9 +224,12 @@ struct	rb_tree_iterator
 		return (tmp);
 	}
 
-	node_ptr	_node;
+	base_ptr	_node;
 };
 
+template <typename Key, typename T, typename Compare, typename Allocator, typename Augment>
+class rb_tree;
+
 template <typename Key, typename T>
 struct	const_rb_tree_iterator
 {
@@ -167,6 +239,7 @@ struct	const_rb_tree_iterator
 	typedef std::bidirectional_iterator_tag	iterator_category;
 	typedef ptrdiff_t	difference_type;
 
+	typedef const rb_node_base*		const_base_ptr;
 	typedef	const rb_node<Key, T>*	const_node_ptr;
 	typedef const_rb_tree_iterator<Key, T>	self;
 	typedef rb_tree_iterator<Key, T>	iterator;
@@ -179,7 +252,7 @@ struct	const_rb_tree_iterator
 		_node()
 		{ }
 
-	const_rb_tree_iterator(const_node_ptr node) :
+	const_rb_tree_iterator(const_base_ptr node) :
 		_node(node)
 		{ }
 	
@@ -199,7 +272,7 @@ struct	const_rb_tree_iterator
 
 	reference	operator*(void) const
 	{
-		return (_node->_key_val);
+		return (static_cast<const_node_ptr>(_node)->_key_val);
 	}
 
 	self&	operator++(void)
@@ -212,7 +285,7 @@ struct	const_rb_tree_iterator
 
 	pointer	operator->(void) const
 	{
-		return (&_node->_key_val);
+		return (&static_cast<const_node_ptr>(_node)->_key_val);
 	}
 
 	self	operator++(int)
@@ -248,148 +321,135 @@ struct	const_rb_tree_iterator
 	}
 
 	private:
-	const_node_ptr	_node;
-};
+	template <typename K, typename U, typename C, typename A, typename G>
+	friend class	rb_tree;
 
-template <typename Key, typename T>
-bool	_is_null_node(rb_node<Key, T>* x)
-{
-	if (x->_is_null == null)
-		return (true);
-	return (false);
-}
-
-template <typename Key, typename T>
-rb_node<Key, T>*	_tree_minimum(rb_node<Key, T>* x)
-{
-	while (!_is_null_node(x->_left))
-		x = x->_left;
-	return (x);
-}
+	const_base_ptr	_node;
+};
 
-template <typename Key, typename T>
-rb_node<Key, T>*	_tree_maximum(rb_node<Key, T>* x)
+// struct that keeps track of the root, the begin, the size and the null node.
+// the null node is embedded, so an empty tree owns no memory at all: it is
+// the end() node and the parent of the root, its _left points to the
+// rightmost node (to itself in an empty tree) and its _p to itself
+struct rb_tree_header
 {
-	while (!_is_null_node(x->_right))
-		x = x->_right;
-	return (x);
-}
+	typedef rb_node_base*	base_ptr;
 
-template <typename Key, typename T>
-rb_node<Key, T>*	_rb_tree_successor(rb_node<Key, T>* x)
-{
-	if (!_is_null_node(x->_right))
-		return (_tree_minimum(x->_right));
-	rb_node<Key, T>*	y = x->_p;
-	while (!_is_null_node(y) && x == y->_right)
+	rb_tree_header(void)
 	{
-		x = y;
-		y = y->_p;
+		_null._is_null = null;
+		_null._p = &_null;
+		reset();
 	}
-	return (y);
-}
 
-template <typename Key, typename T>
-const rb_node<Key, T>*	_rb_tree_successor(const rb_node<Key, T>* x)
-{
-	if (!_is_null_node(x->_right))
-		return (_tree_minimum(x->_right));
-	rb_node<Key, T>*	y = x->_p;
-	while (!_is_null_node(y) && x == y->_right)
+	// the nodes of a tree link back to its own null node,
+	// so only the root and the extremes need fixing after a swap
+	void	swap(rb_tree_header& other)
 	{
-		x = y;
-		y = y->_p;
+		std::swap(_root, other._root);
+		std::swap(_begin, other._begin);
+		std::swap(_null._left, other._null._left);
+		std::swap(_size, other._size);
+		_relink();
+		other._relink();
 	}
-	return (y);
-}
 
-template <typename Key, typename T>
-rb_node<Key, T>*	_rb_tree_predecessor(rb_node<Key, T>* x)
-{
-	if (!_is_null_node(x->_left))
-		return (_tree_maximum(x->_left));
-	rb_node<Key, T>*	y = x->_p;
-	while (!_is_null_node(y) && x == y->_left)
+	void	reset(void)
 	{
-		x = y;
-		y = y->_p;
+		_store_link(_root, NULL);
+		_begin = &_null;
+		_null._left = &_null;
+		_size = 0;
 	}
-	return (y);
-}
 
-template <typename Key, typename T>
-const rb_node<Key, T>*	_rb_tree_predecessor(const rb_node<Key, T>* x)
-{
-	if (!_is_null_node(x->_left))
-		return (_tree_maximum(x->_left));
-	rb_node<Key, T>*	y = x->_p;
-	while (!_is_null_node(y) && x == y->_left)
+	void	_relink(void)
 	{
-		x = y;
-		y = y->_p;
+		if (_root == NULL)
+			reset();
+		else
+			_root->_p = &_null;
 	}
-	return (y);
-}
 
-// struct that keeps track of the root, the begin, end, the size and the null node
-template <typename Key, typename T, typename Allocator>
-struct rb_tree_header
-{
-	typedef rb_node<Key, T>*	node_ptr;
+	base_ptr		_root;
+	base_ptr		_begin;
+	rb_node_base	_null;
+	size_t			_size;
+
+	private:
+	rb_tree_header(const rb_tree_header&);
+	rb_tree_header&	operator=(const rb_tree_header&);
+};
+
+// augmentation policies keep extra data in every node, computed from the
+// node and its children: the tree calls update on a node whenever its
+// children change, bottom up, and copy when it clones a node. a policy
+// that is counted also gives the number of nodes of a subtree, by count.
+// construct builds a node in place, in the memory the tree allocated.
+// the default policy adds nothing and costs nothing
+struct rb_no_augment {
+
+	enum { augmented = 0 };
+	enum { counted = 0 };
+
+	template <typename Key, typename T>
+	struct node {
+		typedef rb_node<Key, T>	type;
+	};
+
+	template <typename Node>
+	static void	update(Node*)
+	{ }
 
-	rb_tree_header(void) :
-		_size(0)
+	template <typename Node>
+	static void	copy(Node*, const Node*)
+	{ }
+
+	template <typename Node, typename Key, typename T>
+	static void	construct(Node* node, const Key& key, const T& val)
 	{
-		_null = Allocator().allocate(1);
-		Allocator().construct(_null, rb_node<Key, T>());
-		_null->_color = black;
-		_null->_is_null = null;
-		_null->_left = _null;
-		_null->_right = _null;
-		_null->_p = _null;
-		_root = _null;
-		_begin = _null;
+		::new (static_cast<void*>(node)) Node(key, val);
 	}
+};
 
-	~rb_tree_header(void) 
+// how the set algebra and the bulk construction of a tree are run: this
+// one runs them on the calling thread. parallel_execution, in parallel.hpp,
+// runs them on several threads, and is kept out of the trees so that they
+// do not pull the threads in
+struct sequential_execution {
+
+	size_t	threads(void) const
 	{
-		Allocator().destroy(__builtin_addressof(*_null));
-		Allocator().deallocate(__builtin_addressof(*_null), 1);
+		return (1);
 	}
 
-	void	swap(rb_tree_header& other)
+	template <typename Task>
+	void	run(Task* tasks, size_t n) const
 	{
-		std::swap(_root, other._root);
-		std::swap(_begin, other._begin);
-		std::swap(_end, other._end);
-		std::swap(_null, other._null);
-		std::swap(_size, other._size);
+		for (size_t i = 0; i < n; i++)
+			tasks[i]();
 	}
 
-	void	reset(void)
+	template <typename RandomIt, typename Compare>
+	void	stable_sort(RandomIt first, RandomIt last, Compare comp) const
 	{
-		_root = _null;
-		_begin = _null;
-		_size = 0;
-		_null->_left = _null;
+		std::stable_sort(first, last, comp);
 	}
-
-	node_ptr	_root;
-	node_ptr	_begin;
-	node_ptr	_end;
-	node_ptr	_null;
-	typename Allocator::size_type	_size;
 };
 
 template <typename Key, typename T,
-	typename Compare, typename Allocator>
+	typename Compare, typename Allocator, typename Augment = rb_no_augment>
 class rb_tree
 {
+	public:
+	typedef typename Augment::template node<Key, T>::type	node_type;
+
 	private:
-	typedef typename Allocator::template rebind<rb_node<Key, T> >::other	node_allocator;
+	typedef typename Allocator::template rebind<node_type>::other	node_allocator;
 
 	public:
-	typedef	rb_node<Key, T>*				node_ptr;
+	typedef node_allocator					node_allocator_type;
+	typedef rb_node_base*					base_ptr;
+	typedef	node_type*						node_ptr;
 	typedef typename node_allocator::size_type	size_type;
 	typedef ptrdiff_t						difference_type;
 	typedef ft::pair<Key, T>				pair_type;
@@ -406,7 +466,9 @@ class rb_tree
 		_comp(from._comp),
 		_alloc(from._alloc)
 	{
-		_rb_tree_copy_range(from.begin(), from.end());
+		base_ptr	reuse = NULL;
+
+		_copy_tree(from, reuse);
 	}
 
 	explicit rb_tree(const Compare& comp, const Allocator& alloc) :
@@ -419,7 +481,7 @@ class rb_tree
 		_comp(comp),
 		_alloc(alloc)
 	{
-		_rb_tree_copy_range(first, last);
+		insert_range(first, last);
 	}
 
 	~rb_tree(void)
@@ -427,11 +489,20 @@ class rb_tree
 		_delete_all_nodes(_head._root);
 	}
 
+	// the nodes already owned by the tree are recycled for the copy,
+	// only the surplus (or the shortfall) goes through the allocator
 	rb_tree&	operator=(const rb_tree& from)
 	{
-		clear();
-		if (from.size() != 0)
-			_rb_tree_copy_range(from.begin(), from.end());
+		base_ptr	reuse;
+
+		if (this != &from)
+		{
+			reuse = _flatten(_head._root);
+			_head.reset();
+			_comp = from._comp;
+			_copy_tree(from, reuse);
+			_delete_list(reuse);
+		}
 		return (*this);
 	}
 
@@ -440,22 +511,24 @@ class rb_tree
 		return (_alloc);
 	}
 
+	const node_allocator_type&	get_node_allocator(void) const
+	{
+		return (_alloc);
+	}
+
+	Compare	key_comp(void) const
+	{
+		return (_comp);
+	}
+
 
 	// lookup
 
 	size_type	count(const Key& key) const
 	{
-		node_ptr	x = _head._begin;
-		size_type	count = 0;
-
-		while (x != _head._null && _comp(x->_key, key))
-			x = _rb_tree_successor(x);
-		while (x != _head._null && !_comp(key, x->_key))
-		{
-			x = _rb_tree_successor(x);
-			count++;
-		}
-		return (count);
+		if (_find_node(key) == _end_node())
+			return (0);
+		return (1);
 	}
 	
 	iterator	find(const Key& key)
@@ -470,560 +543,2157 @@ class rb_tree
 
 	iterator	find_throw(const Key& key)
 	{
-		node_ptr	found = _find_node(key);
+		base_ptr	found = _find_node(key);
 
-		if (found == _head._null)
+		if (found == _end_node())
 			throw std::out_of_range("Key not found");
 		return (found);
 	}
 
 	const_iterator	find_throw(const Key& key) const
 	{
-		node_ptr	found = _find_node(key);
+		base_ptr	found = _find_node(key);
 
-		if (found == _head._null)
+		if (found == _end_node())
 			throw std::out_of_range("Key not found");
 		return (found);
 	}
 
 	iterator	lower_bound(const Key& key)
 	{
-		node_ptr	x = _head._begin;
-
-		while (x != _head._null && _comp(x->_key, key))
-			x = _rb_tree_successor(x);
-		return (x);
+		return (_lower_bound(key));
 	}
 
-	const iterator	lower_bound(const Key& key) const
+	const_iterator	lower_bound(const Key& key) const
 	{
-		node_ptr	x = _head._begin;
-
-		while (x != _head._null && _comp(x->_key, key))
-			x = _rb_tree_successor(x);
-		return (x);
+		return (_lower_bound(key));
 	}
 
 	iterator	upper_bound(const Key& key)
 	{
-		node_ptr	x = _head._begin;
-
-		while (x != _head._null && !_comp(key, x->_key))
-			x = _rb_tree_successor(x);
-		return (x);
+		return (_upper_bound(key));
 	}
 
-	const iterator	upper_bound(const Key& key) const
+	const_iterator	upper_bound(const Key& key) const
 	{
-		node_ptr	x = _head._begin;
-
-		while (x != _head._null && !_comp(key, x->_key))
-			x = _rb_tree_successor(x);
-		return (x);
+		return (_upper_bound(key));
 	}
 
 	ft::pair<iterator, iterator>	equal_range(const Key& key)
 	{
-		node_ptr	x = _head._begin;
+		base_ptr	low = _lower_bound(key);
 
-		while (x != _head._null && _comp(x->_key, key))
-			x = _rb_tree_successor(x);
-		iterator	low(x);
-		while (x != _head._null && !_comp(key, x->_key))
-			x = _rb_tree_successor(x);
-		iterator	up(x);
-		return (ft::make_pair(low, up));
+		return (ft::make_pair(iterator(low), iterator(_equal_range_end(low, key))));
 	}
 
 	ft::pair<const_iterator, const_iterator>	equal_range(const Key& key) const
 	{
-		node_ptr	x = _head._begin;
+		base_ptr	low = _lower_bound(key);
 
-		while (x != _head._null && _comp(x->_key, key))
-			x = _rb_tree_successor(x);
-		const_iterator	low(x);
-		while (x != _head._null && !_comp(key, x->_key))
-			x = _rb_tree_successor(x);
-		const_iterator	up(x);
-		return (ft::make_pair(low, up));
+		return (ft::make_pair(const_iterator(low), const_iterator(_equal_range_end(low, key))));
 	}
 
+	// heterogeneous lookup: only available when Compare declares
+	// is_transparent, in which case it must be able to compare a Key
+	// with a K both ways, and no Key is ever built from the K
 
-	// rb tree modifiers
-
-	void	clear(void)
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, size_type>::type
+	count(const K& key) const
 	{
-		_delete_all_nodes(_head._root);
-		_head.reset();
+		if (_find_node(key) == _end_node())
+			return (0);
+		return (1);
 	}
 
-	ft::pair<iterator, bool>	insert(const Key& key, const T& val)
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, iterator>::type
+	find(const K& key)
 	{
-		node_ptr	in_node;
-		node_ptr	tmp_node;
-
-		in_node = _get_node(key, val);
-		if ((tmp_node = _rb_tree_insert(in_node, _head._root)) != in_node)
-		{
-			_delete_node(in_node);
-			return (ft::make_pair(iterator(tmp_node), false));
-		}
-		if (_head._begin == _head._null || in_node == _rb_tree_predecessor(_head._begin))
-			_head._begin = in_node;
-		if (_head._null->_left == _head._null || in_node == _rb_tree_successor(_head._null->_left))
-			_head._null->_left = in_node;
-		_head._size++;
-		return (ft::make_pair(iterator(in_node), true));
+		return (_find_node(key));
 	}
 
-	iterator	insert(iterator pos, const Key& key, const T& val)
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, const_iterator>::type
+	find(const K& key) const
 	{
-		node_ptr	in_node = _get_node(key, val);
-		node_ptr	tmp_node = _rb_tree_insert(in_node, _head._root);
-
-		(void)pos;
-		if (tmp_node != in_node)
-		{
-			_delete_node(in_node);
-			return (tmp_node);
-		}
-		if (_head._begin == _head._null || in_node == _rb_tree_predecessor(_head._begin))
-			_head._begin = in_node;
-		if (_head._null->_left == _head._null || in_node == _rb_tree_successor(_head._null->_left))
-			_head._null->_left = in_node;
-		_head._size++;
-		return (in_node);
+		return (_find_node(key));
 	}
 
-	// the two _insert functions are just here to simplify
-	// the interface by deconstructing the pairs in two elements
-
-	pair<iterator, bool>	_insert_pair(const pair_type& pair)
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, iterator>::type
+	lower_bound(const K& key)
 	{
-		return (insert(pair.first, pair.second));
+		return (_lower_bound(key));
 	}
 
-	iterator	_insert_pos(iterator pos, const pair_type& pair)
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, const_iterator>::type
+	lower_bound(const K& key) const
 	{
-		return (insert(pos, pair.first, pair.second));
+		return (_lower_bound(key));
 	}
 
-	void	erase(iterator pos)
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, iterator>::type
+	upper_bound(const K& key)
 	{
-		node_ptr	pos_node = pos._node;
-
-		if (pos_node == _head._null)
-			return ;
-		if (pos_node == _head._begin)
-			_head._begin = _rb_tree_successor(_head._begin);
-		if (pos_node == _head._null->_left)
-			_head._null->_left = _rb_tree_predecessor(_head._null->_left);
-		_rb_tree_delete(pos_node);
-		_delete_node(pos_node);
-		_head._size--;
+		return (_upper_bound(key));
 	}
 
-	size_type	erase(const Key& key)
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, const_iterator>::type
+	upper_bound(const K& key) const
 	{
-		node_ptr	pos_node = _find_node(key);
-
-		if (pos_node == _head._null)
-			return (0);
-		if (pos_node == _head._begin)
-			_head._begin = _rb_tree_successor(_head._begin);
-		if (pos_node == _head._null->_left)
-			_head._null->_left = _rb_tree_predecessor(_head._null->_left);
-		_rb_tree_delete(pos_node);
-		_delete_node(pos_node);
-		_head._size--;
-		return (1);
+		return (_upper_bound(key));
 	}
 
-	void	swap(rb_tree& other)
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, ft::pair<iterator, iterator> >::type
+	equal_range(const K& key)
 	{
-		_head.swap(other._head);
-		std::swap(_alloc, other._alloc);
-		std::swap(_comp, other._comp);
-	}
+		base_ptr	low = _lower_bound(key);
 
-	// capacity
+		return (ft::make_pair(iterator(low), iterator(_equal_range_end(low, key))));
+	}
 
-	size_type	size(void) const
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, ft::pair<const_iterator, const_iterator> >::type
+	equal_range(const K& key) const
 	{
-		return (_head._size);
+		base_ptr	low = _lower_bound(key);
+
+		return (ft::make_pair(const_iterator(low), const_iterator(_equal_range_end(low, key))));
 	}
 
-	bool	empty(void) const
+	// looks up every key of [first, last) and writes, in the same order,
+	// an iterator to its element or end(). the keys are compared as they
+	// are: they must be Keys unless Compare is transparent
+	template <typename ForwardIterator, typename OutputIterator>
+	OutputIterator	find_many(ForwardIterator first, ForwardIterator last, OutputIterator out)
 	{
-		return (_head._size == 0);
+		return (_find_many<iterator>(first, last, out));
 	}
 
-	size_type	max_size(void) const
+	template <typename ForwardIterator, typename OutputIterator>
+	OutputIterator	find_many(ForwardIterator first, ForwardIterator last, OutputIterator out) const
 	{
-		return (_alloc.max_size());
+		return (_find_many<const_iterator>(first, last, out));
 	}
 
-	// iterators
 
-	iterator	begin(void)
-	{
-		return (_head._begin);
-	}
+	// rb tree modifiers
 
-	const_iterator	begin(void) const
+	void	clear(void)
 	{
-		return (_head._begin);
+		_delete_all_nodes(_head._root);
+		_head.reset();
 	}
 
-	iterator	end(void)
+	// the node is only allocated once the descent found no equal key
+	ft::pair<iterator, bool>	insert(const Key& key, const T& val)
 	{
-		return (_head._null);
+		return (try_emplace(key, val));
 	}
 
-	const_iterator	end(void) const
+	// pos is a hint: when key belongs right before or right after it,
+	// the node is linked there directly without descending from the root
+	iterator	insert(iterator pos, const Key& key, const T& val)
 	{
-		return (_head._null);
+		return (try_emplace(pos, key, val));
 	}
 
-	reverse_iterator	rbegin(void)
-	{
-		return (reverse_iterator(_head._null));
-	}
+	// the try_emplace and insert_or_assign functions look for the slot of
+	// key first: the mapped value is only built, right into the new node,
+	// when key is not in the tree yet
 
-	const_reverse_iterator	rbegin(void) const
+	ft::pair<iterator, bool>	try_emplace(const Key& key)
 	{
-		return (const_reverse_iterator(_head._null));
+		base_ptr	parent;
+		bool		left;
+		base_ptr	found = _insert_unique_pos(key, parent, left);
+
+		if (found != _end_node())
+			return (ft::make_pair(iterator(found), false));
+		return (ft::make_pair(_emplace_at(parent, left, key, T()), true));
 	}
 
-	reverse_iterator	rend(void)
+	template <typename V>
+	ft::pair<iterator, bool>	try_emplace(const Key& key, const V& val)
 	{
-		return (reverse_iterator(_head._begin));
+		base_ptr	parent;
+		bool		left;
+		base_ptr	found = _insert_unique_pos(key, parent, left);
+
+		if (found != _end_node())
+			return (ft::make_pair(iterator(found), false));
+		return (ft::make_pair(_emplace_at(parent, left, key, val), true));
 	}
 
-	const_reverse_iterator	rend(void) const
+	iterator	try_emplace(iterator pos, const Key& key)
 	{
-		return (const_reverse_iterator(_head._begin));
+		base_ptr	parent;
+		bool		left;
+		base_ptr	found = _hint_unique_pos(pos._node, key, parent, left);
+
+		if (found != _end_node())
+			return (found);
+		return (_emplace_at(parent, left, key, T()));
 	}
 
-	// debug
-	node_ptr	get_root(void) const
+	// inserted, when given, is set to whether key was inserted
+	template <typename V>
+	iterator	try_emplace(iterator pos, const Key& key, const V& val, bool* inserted = NULL)
 	{
-		return (_head._root);
+		base_ptr	parent;
+		bool		left;
+		base_ptr	found = _hint_unique_pos(pos._node, key, parent, left);
+
+		if (inserted != NULL)
+			*inserted = (found == _end_node());
+		if (found != _end_node())
+			return (found);
+		return (_emplace_at(parent, left, key, val));
 	}
 
-	void	print(node_ptr root) const
+	template <typename V>
+	ft::pair<iterator, bool>	insert_or_assign(const Key& key, const V& val)
 	{
-		if (root != _head._null)
+		base_ptr	parent;
+		bool		left;
+		base_ptr	found = _insert_unique_pos(key, parent, left);
+
+		if (found != _end_node())
 		{
-			print(root->_left);
-			std::cout << root->_key << "::" << root->_val << std::endl;
-			print(root->_right);
+			_value(found).second = val;
+			_update_path(found);
+			return (ft::make_pair(iterator(found), false));
 		}
+		return (ft::make_pair(_emplace_at(parent, left, key, val), true));
 	}
 
-
-	private:
-
-	node_ptr	_find_node(const Key& key) const
+	template <typename V>
+	iterator	insert_or_assign(iterator pos, const Key& key, const V& val)
 	{
-		node_ptr	x = _head._root;
+		base_ptr	parent;
+		bool		left;
+		base_ptr	found = _hint_unique_pos(pos._node, key, parent, left);
 
-		while (x != _head._null && x->_key != key)
+		if (found != _end_node())
 		{
-			if (_comp(x->_key, key))
-				x = x->_right;
-			else if (_comp(key, x->_key))
+			_value(found).second = val;
+			_update_path(found);
+			return (found);
+		}
+		return (_emplace_at(parent, left, key, val));
+	}
+
+	// the two _insert functions are just here to simplify
+	// the interface by deconstructing the pairs in two elements
+
+	pair<iterator, bool>	_insert_pair(const pair_type& pair)
+	{
+		return (insert(pair.first, pair.second));
+	}
+
+	iterator	_insert_pos(iterator pos, const pair_type& pair)
+	{
+		return (insert(pos, pair.first, pair.second));
+	}
+
+	// an empty tree filled from a strictly increasing forward range is
+	// built directly in O(n), anything else is inserted element by element
+	// with an end() hint, which is still cheap for sorted input iterators
+	template <typename InputIterator>
+	void	insert_range(InputIterator first, InputIterator last)
+	{
+		_insert_range(first, last,
+			typename ft::iterator_traits<InputIterator>::iterator_category());
+	}
+
+	// replaces the content of the tree with the pairs of [first, last), in
+	// any order: they are copied, stable sorted as exec runs it, the first
+	// of each run of equivalent keys is kept, as insert would, then the
+	// tree is built in O(n). the last two steps are serial
+	template <typename InputIterator, typename Execution>
+	void	assign_unsorted(InputIterator first, InputIterator last, const Execution& exec)
+	{
+		typedef typename Allocator::template rebind<pair_type>::other	pair_allocator;
+		typedef ft::vector<pair_type, pair_allocator>					pair_vector;
+
+		pair_vector	pairs((pair_allocator(_alloc)));
+		_pair_less	less = { _comp };
+		_pair_equiv	equiv = { _comp };
+
+		pairs.insert(pairs.end(), first, last);
+		exec.stable_sort(pairs.begin(), pairs.end(), less);
+		pairs.erase(std::unique(pairs.begin(), pairs.end(), equiv), pairs.end());
+		clear();
+		_build_tree(pairs.begin(), pairs.size());
+	}
+
+	void	erase(iterator pos)
+	{
+		if (pos._node != _end_node())
+			_erase_node(pos._node);
+	}
+
+	size_type	erase(const Key& key)
+	{
+		return (_erase_key(key));
+	}
+
+	// the whole tree is cleared directly, short ranges are erased node by
+	// node, longer ones are split out of the tree in one go
+	void	erase(iterator first, iterator last)
+	{
+		base_ptr	x = first._node;
+		size_type	n = 0;
+
+		if (first._node == _head._begin && last._node == _end_node())
+		{
+			clear();
+			return ;
+		}
+		while (x != last._node && n < _short_range)
+		{
+			x = _rb_tree_successor(x);
+			n++;
+		}
+		if (x != last._node)
+			_erase_range(first._node, last._node);
+		else
+		{
+			while (first != last)
+				_erase_node((first++)._node);
+		}
+	}
+
+	template <typename K>
+	typename ft::enable_if_transparent<Compare, K, size_type>::type
+	erase(const K& key)
+	{
+		return (_erase_key(key));
+	}
+
+	// node handles: nodes move between trees without being reallocated.
+	// a node handed to another tree must come from an equal allocator
+
+	node_ptr	extract_node(iterator pos)
+	{
+		if (pos._node == _end_node())
+			return (NULL);
+		_unlink_node(pos._node);
+		return (static_cast<node_ptr>(pos._node));
+	}
+
+	// z is left alone if its key is already in the tree
+	ft::pair<iterator, bool>	insert_node(node_ptr z)
+	{
+		base_ptr	parent;
+		bool		left;
+		base_ptr	found = _insert_unique_pos(_key(z), parent, left);
+
+		if (found != _end_node())
+			return (ft::make_pair(iterator(found), false));
+		_rb_tree_link(z, parent, left);
+		return (ft::make_pair(iterator(z), true));
+	}
+
+	iterator	insert_node(iterator pos, node_ptr z)
+	{
+		base_ptr	parent;
+		bool		left;
+		base_ptr	found = _hint_unique_pos(pos._node, _key(z), parent, left);
+
+		if (found != _end_node())
+			return (found);
+		_rb_tree_link(z, parent, left);
+		return (z);
+	}
+
+	// moves the nodes of source whose keys are not in the tree yet.
+	// they are relinked when both allocators are equal, copied (and
+	// freed from source) otherwise
+	void	merge(rb_tree& source)
+	{
+		base_ptr	x;
+		base_ptr	next;
+		base_ptr	parent;
+		bool		left;
+		bool		same_alloc = (_alloc == source._alloc);
+
+		if (this == &source)
+			return ;
+		x = source._head._begin;
+		while (x != source._end_node())
+		{
+			next = _rb_tree_successor(x);
+			if (_insert_unique_pos(_key(x), parent, left) == _end_node())
+			{
+				if (same_alloc)
+				{
+					source._unlink_node(x);
+					_rb_tree_link(x, parent, left);
+				}
+				else
+				{
+					_emplace_at(parent, left, _key(x), _value(x).second);
+					source._erase_node(x);
+				}
+			}
+			x = next;
+		}
+	}
+
+	// moves the nodes whose keys are not lower than key into upper, which
+	// takes the comparator and the allocator of the tree. O(log n) with
+	// the policies that count the nodes of every subtree (see
+	// rb_rank_augment). otherwise the sizes of both sides have to be
+	// counted: O(log n + min(k, n - k)) for k nodes left in the tree
+	template <typename K>
+	void	split(const K& key, rb_tree& upper)
+	{
+		base_ptr	l;
+		base_ptr	r;
+		size_type	lh;
+		size_type	rh;
+		size_type	size = _head._size;
+		size_type	lsize;
+
+		if (this == &upper)
+			return ;
+		upper.clear();
+		upper._comp = _comp;
+		upper._alloc = _alloc;
+		if (_head._root == NULL)
+			return ;
+		_head._root->_p = _end_node();
+		_split(_head._root, _black_height(_head._root), key, l, lh, r, rh);
+		lsize = _split_size(l, r, size, typename ft::bool_type<Augment::counted>::type());
+		_install(l, lsize);
+		upper._install(r, size - lsize);
+	}
+
+	// appends the nodes of other, whose keys must all be lower or all be
+	// greater than the keys of the tree, in O(log n). overlapping trees,
+	// or trees with unequal allocators, are merged instead: other then
+	// keeps the nodes whose keys were already in the tree
+	void	join(rb_tree& other)
+	{
+		base_ptr	l;
+		base_ptr	r;
+		size_type	h;
+		size_type	size;
+
+		if (this == &other || other._head._root == NULL)
+			return ;
+		if (_head._root == NULL && _alloc == other._alloc)
+		{
+			_head.swap(other._head);
+			return ;
+		}
+		if (_alloc != other._alloc || _head._root == NULL
+			|| !(_comp(_key(_head._null._left), _key(other._head._begin))
+				|| _comp(_key(other._head._null._left), _key(_head._begin))))
+		{
+			merge(other);
+			return ;
+		}
+		l = _head._root;
+		r = other._head._root;
+		if (!_comp(_key(_head._null._left), _key(other._head._begin)))
+			std::swap(l, r);
+		size = _head._size + other._head._size;
+		l->_p = _end_node();
+		r->_p = _end_node();
+		other._head.reset();
+		_install(_join2(l, _black_height(l), r, _black_height(r), h), size);
+	}
+
+	// set algebra, with other's keys: unite moves in the nodes of other
+	// whose keys are missing and frees the others, intersect and subtract
+	// erase the nodes whose keys are missing from, or present in, other.
+	// the independent subtrees are processed as exec runs them.
+	// nodes only move between trees of equal allocators, unite copies them
+	// otherwise. when the comparator throws, or a task run by exec does,
+	// the nodes the operation holds are freed: the tree is left empty, and
+	// so is other after unite
+
+	template <typename Execution>
+	void	unite(rb_tree& other, const Execution& exec)
+	{
+		if (this == &other)
+			return ;
+		if (_alloc != other._alloc || (exec.threads() <= 1 && _much_smaller(other, _unite_ratio)))
+		{
+			merge(other);
+			other.clear();
+			return ;
+		}
+		_run_union(other, exec);
+	}
+
+	template <typename Execution>
+	void	intersect(const rb_tree& other, const Execution& exec)
+	{
+		if (this == &other)
+			return ;
+		_run_filter(_set_intersection, other, exec);
+	}
+
+	template <typename Execution>
+	void	subtract(const rb_tree& other, const Execution& exec)
+	{
+		if (this == &other)
+		{
+			clear();
+			return ;
+		}
+		if (exec.threads() <= 1 && _much_smaller(other, _subtract_ratio))
+		{
+			for (const_iterator it = other.begin(); it != other.end(); ++it)
+				_erase_key(it->first);
+			return ;
+		}
+		_run_filter(_set_difference, other, exec);
+	}
+
+	void	swap(rb_tree& other)
+	{
+		_head.swap(other._head);
+		std::swap(_alloc, other._alloc);
+		std::swap(_comp, other._comp);
+	}
+
+	// capacity
+
+	size_type	size(void) const
+	{
+		return (_head._size);
+	}
+
+	bool	empty(void) const
+	{
+		return (_head._root == NULL);
+	}
+
+	size_type	max_size(void) const
+	{
+		return (_alloc.max_size());
+	}
+
+	// iterators
+
+	iterator	begin(void)
+	{
+		return (_head._begin);
+	}
+
+	const_iterator	begin(void) const
+	{
+		return (_head._begin);
+	}
+
+	iterator	end(void)
+	{
+		return (_end_node());
+	}
+
+	const_iterator	end(void) const
+	{
+		return (_end_node());
+	}
+
+	reverse_iterator	rbegin(void)
+	{
+		return (reverse_iterator(_end_node()));
+	}
+
+	const_reverse_iterator	rbegin(void) const
+	{
+		return (const_reverse_iterator(_end_node()));
+	}
+
+	reverse_iterator	rend(void)
+	{
+		return (reverse_iterator(_head._begin));
+	}
+
+	const_reverse_iterator	rend(void) const
+	{
+		return (const_reverse_iterator(_head._begin));
+	}
+
+	// order statistics, for the policies that count the nodes of every
+	// subtree (see rb_rank_augment): O(log n) instead of O(n)
+
+	// node of rank k (the first one has rank 0), or the end node
+	base_ptr	nth(size_type k) const
+	{
+		base_ptr	x = _head._root;
+		size_type	left;
+
+		while (x != NULL)
+		{
+			left = _subtree_count(x->_left);
+			if (k < left)
 				x = x->_left;
+			else if (k == left)
+				return (x);
+			else
+			{
+				k -= left + 1;
+				x = x->_right;
+			}
 		}
-		return (x);
+		return (_end_node());
 	}
 
-	// insert helper functions
+	// number of keys lower than key
+	template <typename K>
+	size_type	rank(const K& key) const
+	{
+		base_ptr	x = _head._root;
+		size_type	ret = 0;
+
+		while (x != NULL)
+		{
+			if (_comp(_key(x), key))
+			{
+				ret += _subtree_count(x->_left) + 1;
+				x = x->_right;
+			}
+			else
+				x = x->_left;
+		}
+		return (ret);
+	}
+
+	// rank of the node at position, the size of the tree for end()
+	size_type	index_of(const_iterator position) const
+	{
+		const rb_node_base*	x = position._node;
+		size_type			ret;
+
+		if (x == _end_node())
+			return (_subtree_count(_head._root));
+		ret = _subtree_count(x->_left);
+		while (!_is_null_node(x->_p))
+		{
+			if (x == x->_p->_right)
+				ret += _subtree_count(x->_p->_left) + 1;
+			x = x->_p;
+		}
+		return (ret);
+	}
+
+	// the augmented data of a node follows its value: after the value at
+	// position was changed in place, refresh recomputes it up to the root
+	void	refresh(iterator position)
+	{
+		_update_path(position._node);
+	}
+
+	// debug
+	// loaded with acquire order, for the lockless readers of concurrent_map
+	base_ptr	get_root(void) const
+	{
+		return (__atomic_load_n(&_head._root, __ATOMIC_ACQUIRE));
+	}
+
+	void	print(base_ptr root) const
+	{
+		if (root != NULL)
+		{
+			print(root->_left);
+			std::cout << _key(root) << "::" << _value(root).second << std::endl;
+			print(root->_right);
+		}
+	}
+
+
+	private:
+
+	// ranges up to this length are erased node by node
+	enum { _short_range = 32 };
+
+	// number of descents find_many keeps in flight
+	enum { _find_lanes = 16 };
+
+	base_ptr	_end_node(void) const
+	{
+		return (const_cast<base_ptr>(&_head._null));
+	}
+
+	// augmentation hooks, that compile to nothing with rb_no_augment
+
+	void	_update(base_ptr x)
+	{
+		Augment::update(static_cast<node_ptr>(x));
+	}
+
+	// updates x and its ancestors, up to the root of its tree or subtree
+	void	_update_path(base_ptr x)
+	{
+		if (!Augment::augmented)
+			return ;
+		while (x != NULL && x != _end_node())
+		{
+			_update(x);
+			x = x->_p;
+		}
+	}
+
+	// node accessors: the tree only links rb_node_base, the
+	// key/value pair lives in the rb_node that derives from it
+
+	static pair_type&	_value(base_ptr x)
+	{
+		return (static_cast<node_ptr>(x)->_key_val);
+	}
+
+	static size_type	_subtree_count(const rb_node_base* x)
+	{
+		return (Augment::template count<node_type>(x));
+	}
+
+	static const Key&	_key(const rb_node_base* x)
+	{
+		return (static_cast<const rb_node<Key, T>*>(x)->_key_val.first);
+	}
+
+	// the descents of up to _find_lanes keys take one step each in turn,
+	// and the child each of them moves to is prefetched: by the time a
+	// lane is back to its node, the miss has overlapped with the others
+	template <typename Iterator, typename ForwardIterator, typename OutputIterator>
+	OutputIterator	_find_many(ForwardIterator first, ForwardIterator last, OutputIterator out) const
+	{
+		ForwardIterator	keys[_find_lanes];
+		base_ptr		x[_find_lanes];
+		base_ptr		y[_find_lanes];
+		size_type		lanes;
+		size_type		active;
+
+		while (first != last)
+		{
+			for (lanes = 0; lanes < _find_lanes && first != last; ++lanes, ++first)
+			{
+				keys[lanes] = first;
+				x[lanes] = _head._root;
+				y[lanes] = _end_node();
+			}
+			active = lanes;
+			while (active != 0)
+			{
+				active = 0;
+				for (size_type i = 0; i < lanes; i++)
+				{
+					if (x[i] == NULL)
+						continue ;
+					if (!_comp(_key(x[i]), *keys[i]))
+					{
+						y[i] = x[i];
+						x[i] = x[i]->_left;
+					}
+					else
+						x[i] = x[i]->_right;
+					if (x[i] != NULL)
+					{
+						__builtin_prefetch(x[i]);
+						active++;
+					}
+				}
+			}
+			for (size_type i = 0; i < lanes; i++)
+			{
+				if (y[i] != _end_node() && _comp(*keys[i], _key(y[i])))
+					y[i] = _end_node();
+				*out++ = Iterator(y[i]);
+			}
+		}
+		return (out);
+	}
+
+	template <typename K>
+	base_ptr	_find_node(const K& key) const
+	{
+		base_ptr	x = _lower_bound(key);
+
+		if (x == _end_node() || _comp(key, _key(x)))
+			return (_end_node());
+		return (x);
+	}
+
+	// lower/upper bound both descend from the root, remembering the last
+	// node where the search went left: O(log n) instead of a linear scan
+
+	template <typename K>
+	base_ptr	_lower_bound(const K& key) const
+	{
+		base_ptr	x = _head._root;
+		base_ptr	y = _end_node();
+
+		while (x != NULL)
+		{
+			if (!_comp(_key(x), key))
+			{
+				y = x;
+				x = x->_left;
+			}
+			else
+				x = x->_right;
+		}
+		return (y);
+	}
+
+	template <typename K>
+	base_ptr	_upper_bound(const K& key) const
+	{
+		base_ptr	x = _head._root;
+		base_ptr	y = _end_node();
+
+		while (x != NULL)
+		{
+			if (_comp(key, _key(x)))
+			{
+				y = x;
+				x = x->_left;
+			}
+			else
+				x = x->_right;
+		}
+		return (y);
+	}
+
+	// keys are unique: the range holds at most the node found by lower_bound
+	template <typename K>
+	base_ptr	_equal_range_end(base_ptr low, const K& key) const
+	{
+		if (low != _end_node() && !_comp(key, _key(low)))
+			return (_rb_tree_successor(low));
+		return (low);
+	}
+
+	template <typename K>
+	size_type	_erase_key(const K& key)
+	{
+		base_ptr	pos_node = _find_node(key);
+
+		if (pos_node == _end_node())
+			return (0);
+		_erase_node(pos_node);
+		return (1);
+	}
+
+	// insert helper functions
+
+	// finds where key would be linked with a single comparison per level.
+	// the last node where the descent went right is the only one that can
+	// hold key: it is returned if it does, the null node otherwise
+	base_ptr	_insert_unique_pos(const Key& key, base_ptr& parent, bool& left) const
+	{
+		base_ptr	x = _head._root;
+		base_ptr	last_right = NULL;
+
+		parent = _end_node();
+		left = true;
+		while (x != NULL)
+		{
+			parent = x;
+			if ((left = _comp(key, _key(x))))
+				x = x->_left;
+			else
+			{
+				last_right = x;
+				x = x->_right;
+			}
+		}
+		if (last_right != NULL && !_comp(_key(last_right), key))
+			return (last_right);
+		return (_end_node());
+	}
+
+	// uses pos as a hint for where key belongs. returns the node holding
+	// key if pos already does. otherwise parent and left are set to the link
+	// position right before or right after pos, or parent is set to the null
+	// node when key does not belong next to pos
+	base_ptr	_hint_link_pos(base_ptr pos, const Key& key, base_ptr& parent, bool& left) const
+	{
+		base_ptr	rightmost = _head._null._left;
+		base_ptr	other;
+
+		parent = _end_node();
+		left = false;
+		if (_head._root == NULL)
+			return (_end_node());
+		if (pos == _end_node())
+		{
+			if (_comp(_key(rightmost), key))
+				parent = rightmost;
+			return (_end_node());
+		}
+		if (_comp(key, _key(pos)))
+		{
+			left = true;
+			if (pos == _head._begin)
+				parent = pos;
+			else if (_comp(_key(other = _rb_tree_predecessor(pos)), key))
+			{
+				// either the predecessor has no right child or pos is the
+				// leftmost node of that right subtree and has no left child
+				if (other->_right == NULL)
+				{
+					parent = other;
+					left = false;
+				}
+				else
+					parent = pos;
+			}
+			return (_end_node());
+		}
+		if (_comp(_key(pos), key))
+		{
+			if (pos == rightmost)
+				parent = pos;
+			else if (_comp(key, _key(other = _rb_tree_successor(pos))))
+			{
+				if (pos->_right == NULL)
+					parent = pos;
+				else
+				{
+					parent = other;
+					left = true;
+				}
+			}
+			return (_end_node());
+		}
+		return (pos);
+	}
+
+	// same as _insert_unique_pos, but tries the hint first
+	base_ptr	_hint_unique_pos(base_ptr pos, const Key& key, base_ptr& parent, bool& left) const
+	{
+		base_ptr	found = _hint_link_pos(pos, key, parent, left);
+
+		if (found == _end_node() && parent == _end_node())
+			return (_insert_unique_pos(key, parent, left));
+		return (found);
+	}
+
+	node_ptr	_emplace_at(base_ptr parent, bool left, const Key& key, const T& val)
+	{
+		node_ptr	in_node = _get_node(key, val);
+
+		_rb_tree_link(in_node, parent, left);
+		return (in_node);
+	}
+
+	// links the leaf z as the left or right child of parent
+	// (or as the root if parent is the null node) and rebalances.
+	// z is the new begin only if it is the left child of the old one,
+	// and the new rightmost node only if it is the right child of the old
+	// one, so the cached extremes are kept without walking the tree
+	void	_rb_tree_link(base_ptr z, base_ptr parent, bool left)
+	{
+		z->_p = parent;
+		_store_link(z->_left, NULL);
+		_store_link(z->_right, NULL);
+		z->_color = red;
+		if (parent == _end_node())
+		{
+			_store_link(_head._root, z);
+			_head._begin = z;
+			_head._null._left = z;
+		}
+		else if (left)
+		{
+			_store_link(parent->_left, z);
+			if (parent == _head._begin)
+				_head._begin = z;
+		}
+		else
+		{
+			_store_link(parent->_right, z);
+			if (parent == _head._null._left)
+				_head._null._left = z;
+		}
+		_update_path(z);
+		_rb_tree_color_fixup(z, _head._root);
+		_head._size++;
+	}
+
+	// the rebalancing functions work on the tree held by root: _head._root,
+	// or a subtree detached by the split and join functions, whose root
+	// then has the null node as parent too.
+	// returns true if the root had to be turned black, which adds one
+	// to the black height of the tree
+	bool	_rb_tree_color_fixup(base_ptr z, base_ptr& root)
+	{
+		base_ptr	y;
+
+		while (z->_p->_color == red)
+		{
+			if (z->_p == z->_p->_p->_left)
+			{
+				y = z->_p->_p->_right;
+				if (y != NULL && y->_color == red)
+				{
+					z->_p->_color = black;
+					y->_color = black;
+					z->_p->_p->_color = red;
+					z = z->_p->_p;
+				}
+				else
+				{
+					if (z == z->_p->_right)
+					{
+						z = z->_p;
+						_left_rotate(z, root);
+					}
+					z->_p->_color = black;
+					z->_p->_p->_color = red;
+					_right_rotate(z->_p->_p, root);
+				}
+			}
+			else
+			{
+				y = z->_p->_p->_left;
+				if (y != NULL && y->_color == red)
+				{
+					z->_p->_color = black;
+					y->_color = black;
+					z->_p->_p->_color = red;
+					z = z->_p->_p;
+				}
+				else
+				{
+					if (z == z->_p->_left)
+					{
+						z = z->_p;
+						_right_rotate(z, root);
+					}
+					z->_p->_color = black;
+					z->_p->_p->_color = red;
+					_left_rotate(z->_p->_p, root);
+				}
+			}
+		}
+		if (root->_color == black)
+			return (false);
+		root->_color = black;
+		return (true);
+	}
+
+	// delete helper functions
+
+	void	_erase_node(base_ptr z)
+	{
+		_unlink_node(z);
+		_delete_node(z);
+	}
+
+	// takes z out of the tree without freeing it.
+	// begin has no left child, so its successor is either its right child,
+	// which can only be a red leaf, or its parent. the rightmost node is
+	// handled the same way, mirrored
+	void	_unlink_node(base_ptr z)
+	{
+		if (z == _head._begin)
+			_head._begin = (z->_right != NULL) ? z->_right : z->_p;
+		if (z == _head._null._left)
+			_head._null._left = (z->_left != NULL) ? z->_left : z->_p;
+		_rb_tree_delete(z, _head._root);
+		_head._size--;
+	}
+
+	// as the leaves are NULL links, the parent of x is tracked
+	// separately for the fixup: x itself may be NULL
+	void	_rb_tree_delete(base_ptr z, base_ptr& root)
+	{
+		base_ptr	x;
+		base_ptr	x_parent;
+		base_ptr	y = z;
+		unsigned char	y_orig_color = y->_color;
+
+		if (z->_left == NULL)
+		{
+			x = z->_right;
+			x_parent = z->_p;
+			_transplant(z, z->_right, root);
+		}
+		else if (z->_right == NULL)
+		{
+			x = z->_left;
+			x_parent = z->_p;
+			_transplant(z, z->_left, root);
+		}
+		else
+		{
+			y = _tree_minimum(z->_right);
+			y_orig_color = y->_color;
+			x = y->_right;
+			if (y->_p == z)
+				x_parent = y;
+			else
+			{
+				x_parent = y->_p;
+				_transplant(y, y->_right, root);
+				_store_link(y->_right, z->_right);
+				y->_right->_p = y;
+			}
+			_transplant(z, y, root);
+			_store_link(y->_left, z->_left);
+			y->_left->_p = y;
+			y->_color = z->_color;
+		}
+		_update_path(x_parent);
+		if (y_orig_color == black)
+			_rb_delete_fixup(x, x_parent, root);
+	}
+
+	static bool	_is_black(base_ptr x)
+	{
+		return (x == NULL || x->_color == black);
+	}
+
+	void	_rb_delete_fixup(base_ptr x, base_ptr x_parent, base_ptr& root)
+	{
+		base_ptr	w;
+
+		while (x != root && _is_black(x))
+		{
+			if (x == x_parent->_left)
+			{
+				w = x_parent->_right;
+				if (w->_color == red)
+				{
+					w->_color = black;
+					x_parent->_color = red;
+					_left_rotate(x_parent, root);
+					w = x_parent->_right;
+				}
+				if (_is_black(w->_left) && _is_black(w->_right))
+				{
+					w->_color = red;
+					x = x_parent;
+					x_parent = x_parent->_p;
+				}
+				else
+				{
+					if (_is_black(w->_right))
+					{
+						w->_left->_color = black;
+						w->_color = red;
+						_right_rotate(w, root);
+						w = x_parent->_right;
+					}
+					w->_color = x_parent->_color;
+					x_parent->_color = black;
+					w->_right->_color = black;
+					_left_rotate(x_parent, root);
+					x = root;
+				}
+			}
+			else
+			{
+				w = x_parent->_left;
+				if (w->_color == red)
+				{
+					w->_color = black;
+					x_parent->_color = red;
+					_right_rotate(x_parent, root);
+					w = x_parent->_left;
+				}
+				if (_is_black(w->_right) && _is_black(w->_left))
+				{
+					w->_color = red;
+					x = x_parent;
+					x_parent = x_parent->_p;
+				}
+				else
+				{
+					if (_is_black(w->_left))
+					{
+						w->_right->_color = black;
+						w->_color = red;
+						_left_rotate(w, root);
+						w = x_parent->_left;
+					}
+					w->_color = x_parent->_color;
+					x_parent->_color = black;
+					w->_left->_color = black;
+					_right_rotate(x_parent, root);
+					x = root;
+				}
+			}
+		}
+		if (x != NULL)
+			x->_color = black;
+	}
+
+	void	_transplant(base_ptr u, base_ptr v, base_ptr& root)
+	{
+		if (u->_p == _end_node())
+			_store_link(root, v);
+		else if (u == u->_p->_left)
+			_store_link(u->_p->_left, v);
+		else
+			_store_link(u->_p->_right, v);
+		if (v != NULL)
+			v->_p = u->_p;
+	}
+
+	void	_left_rotate(base_ptr x, base_ptr& root)
+	{
+		base_ptr	y = x->_right;
+
+		_store_link(x->_right, y->_left);
+		if (y->_left != NULL)
+			y->_left->_p = x;
+		y->_p = x->_p;
+		// these 3 conditions replace x by y in x's former parent
+		if (x->_p == _end_node())
+			_store_link(root, y);
+		else if (x == x->_p->_left)
+			_store_link(x->_p->_left, y);
+		else
+			_store_link(x->_p->_right, y);
+		_store_link(y->_left, x);
+		x->_p = y;
+		_update(x);
+		_update(y);
+	}
+
+	void	_right_rotate(base_ptr y, base_ptr& root)
+	{
+		base_ptr	x = y->_left;
+
+		_store_link(y->_left, x->_right);
+		if (x->_right != NULL)
+			x->_right->_p = y;
+		x->_p = y->_p;
+		if (y->_p == _end_node())
+			_store_link(root, x);
+		else if (y == y->_p->_left)
+			_store_link(y->_p->_left, x);
+		else
+			_store_link(y->_p->_right, x);
+		_store_link(x->_right, y);
+		y->_p = x;
+		_update(y);
+		_update(x);
+	}
+
+	// split and join functions
+
+	// they work on detached subtrees, whose roots have the null node as
+	// parent and may be red. the black heights are passed along: they do
+	// not count the NULL leaves, so an empty subtree has a height of 0
+
+	static size_type	_black_height(const rb_node_base* x)
+	{
+		size_type	h = 0;
+
+		while (x != NULL)
+		{
+			h += (x->_color == black);
+			x = x->_left;
+		}
+		return (h);
+	}
+
+	// a red root can always be turned black, joins start from black roots
+	static void	_blacken_root(base_ptr x, size_type& h)
+	{
+		if (x != NULL && x->_color == red)
+		{
+			x->_color = black;
+			h++;
+		}
+	}
+
+	// joins l, the node k and r, where every key of l is lower than the key
+	// of k and every key of r is greater. the shorter tree hangs from the
+	// spine of the taller one, at the first black node of the same black
+	// height, so the cost is in O(1 + |lh - rh|). sets h to the black height
+	// of the result
+	base_ptr	_join(base_ptr l, size_type lh, base_ptr k, base_ptr r, size_type rh, size_type& h)
+	{
+		base_ptr	root;
+		base_ptr	parent;
+		base_ptr	c;
+		size_type	ch;
+
+		_blacken_root(l, lh);
+		_blacken_root(r, rh);
+		k->_color = red;
+		if (lh == rh)
+		{
+			k->_left = l;
+			k->_right = r;
+			k->_p = _end_node();
+			if (l != NULL)
+				l->_p = k;
+			if (r != NULL)
+				r->_p = k;
+			_update(k);
+			h = lh;
+			return (k);
+		}
+		root = (lh > rh) ? l : r;
+		c = root;
+		ch = (lh > rh) ? lh : rh;
+		parent = _end_node();
+		while (c != NULL && !(c->_color == black && ch == ((lh > rh) ? rh : lh)))
+		{
+			parent = c;
+			ch -= (c->_color == black);
+			c = (lh > rh) ? c->_right : c->_left;
+		}
+		if (lh > rh)
+		{
+			k->_left = c;
+			k->_right = r;
+			parent->_right = k;
+		}
+		else
+		{
+			k->_left = l;
+			k->_right = c;
+			parent->_left = k;
+		}
+		k->_p = parent;
+		if (k->_left != NULL)
+			k->_left->_p = k;
+		if (k->_right != NULL)
+			k->_right->_p = k;
+		_update_path(k);
+		h = ((lh > rh) ? lh : rh) + _rb_tree_color_fixup(k, root);
+		return (root);
+	}
+
+	// joins l and r without a middle node: the minimum of r is taken out
+	// of it to serve as one. sets h to the black height of the result
+	base_ptr	_join2(base_ptr l, size_type lh, base_ptr r, size_type rh, size_type& h)
+	{
+		base_ptr	k;
+
+		if (l == NULL || r == NULL)
+		{
+			h = (l == NULL) ? rh : lh;
+			return ((l == NULL) ? r : l);
+		}
+		k = _tree_minimum(r);
+		_rb_tree_delete(k, r);
+		return (_join(l, lh, k, r, _black_height(r), h));
+	}
+
+	// splits the subtree t of black height th into l, holding the keys
+	// lower than key, and r, holding the others. when found is given, the
+	// node of key is kept out of r and returned in it, detached (NULL if
+	// there is none). the keys are all compared before the first link is
+	// changed, so that a throwing comparator leaves t as it was
+	template <typename K>
+	void	_split(base_ptr t, size_type th, const K& key,
+		base_ptr& l, size_type& lh, base_ptr& r, size_type& rh, base_ptr* found = NULL)
+	{
+		base_ptr	path[128];
+		base_ptr	x = NULL;
+		bool		equal;
+
+		for (base_ptr y = t; y != NULL; )
+		{
+			if (!_comp(_key(y), key))
+			{
+				x = y;
+				y = y->_left;
+			}
+			else
+				y = y->_right;
+		}
+		equal = (found != NULL && x != NULL && !_comp(key, _key(x)));
+		if (found != NULL)
+			*found = NULL;
+		if (x == NULL)
+		{
+			l = t;
+			lh = th;
+			r = NULL;
+			rh = 0;
+			return ;
+		}
+		_path_to(x, path);
+		_split_at(t, th, path, x, l, lh, r, rh, equal ? found : NULL);
+	}
+
+	// set operations on detached subtrees, after the join based algorithms
+	// of Blelloch, Ferizovic and Sun: the root of t2 splits t1, both sides
+	// are processed recursively, independently of each other, and joined
+	// back, in O(m log(n / m + 1)) for m <= n nodes in the trees.
+	// the union takes the nodes of t2, the other two only read t2.
+	// the nodes left out are put on drop, to be freed by the caller, so
+	// that the subtrees can be processed on several threads without
+	// going through the allocator
+
+	enum _set_op { _set_union, _set_intersection, _set_difference };
+
+	// subtrees to free, chained through their roots' _p
+	struct _drop_list {
+		base_ptr	first;
+		base_ptr	last;
+
+		void	push(base_ptr x)
+		{
+			x->_p = NULL;
+			if (first == NULL)
+				first = x;
+			else
+				last->_p = x;
+			last = x;
+		}
+
+		void	append(const _drop_list& other)
+		{
+			if (other.first == NULL)
+				return ;
+			if (first == NULL)
+				first = other.first;
+			else
+				last->_p = other.first;
+			last = other.last;
+		}
+	};
+
+	// below this black height (some thousands of nodes), the subtrees
+	// are not worth a thread of their own
+	enum { _parallel_black_height = 10 };
+
+	// on one thread, the splits and joins only pay off from these ratios
+	// of sizes on: a smaller other is merged or erased key by key
+	enum { _unite_ratio = 32, _subtract_ratio = 4 };
+
+	bool	_much_smaller(const rb_tree& other, size_type ratio) const
+	{
+		return (other._head._size * ratio < _head._size);
+	}
+
+	// one side of a set operation. NodePtr is the type of the nodes of t2:
+	// base_ptr for the union, const for the operations that only read it
+	template <typename Execution, typename NodePtr>
+	struct _set_op_task {
+		rb_tree*			tree;
+		const Execution*	exec;
+		_set_op				op;
+		base_ptr			t1;
+		size_type			h1;
+		NodePtr				t2;
+		size_type			h2;
+		size_type			threads;
+		base_ptr			result;
+		size_type			h;
+		_drop_list			drop;
+
+		// t1 and t2 are handed over to _set_operation, which puts what it
+		// holds on drop if it throws
+		void	operator()(void)
+		{
+			base_ptr	x1 = t1;
+			NodePtr		x2 = t2;
+
+			t1 = NULL;
+			t2 = NULL;
+			result = tree->_set_operation(*exec, op, x1, h1, x2, h2, h, drop, threads);
+		}
+	};
+
+	// puts on drop a subtree of t2 that was not handed over yet: only the
+	// union owns the nodes of t2
+	static void	_drop_owned(_drop_list& drop, base_ptr x)
+	{
+		if (x != NULL)
+			drop.push(x);
+	}
+
+	static void	_drop_owned(_drop_list&, const rb_node_base*)
+	{
+	}
 
-	// actual insert function
-	node_ptr	_rb_tree_insert(node_ptr z, node_ptr start)
+	// the union, which takes the nodes of t2
+	template <typename Execution>
+	base_ptr	_set_operation(const Execution& exec, _set_op op, base_ptr t1, size_type h1,
+		base_ptr t2, size_type h2, size_type& h, _drop_list& drop, size_type threads)
 	{
-		node_ptr	y = _head._null;
-		node_ptr	x = start;
+		base_ptr							found;
+		base_ptr							l2;
+		base_ptr							r2;
+		_set_op_task<Execution, base_ptr>	tasks[2];
 
-		while (x != _head._null)
+		if (t1 == NULL || t2 == NULL)
 		{
-			y = x;
-			if (_comp(z->_key, x->_key))
-				x = x->_left;
-			else if (_comp(x->_key, z->_key))
-				x = x->_right;
-			else
-				return (x);
+			h = (t1 == NULL) ? h2 : h1;
+			return ((t1 == NULL) ? t2 : t1);
+		}
+		try
+		{
+			_split(t1, h1, _key(t2), tasks[0].t1, tasks[0].h1, tasks[1].t1, tasks[1].h1, &found);
+		}
+		catch (...)
+		{
+			drop.push(t1);
+			drop.push(t2);
+			throw ;
 		}
-		z->_p = y;
-		if (y == _head._null)
-			_head._root = z;
-		else if (_comp(z->_key, y->_key))
-			y->_left = z;
+		l2 = t2->_left;
+		r2 = t2->_right;
+		if (l2 != NULL)
+			l2->_p = _end_node();
+		if (r2 != NULL)
+			r2->_p = _end_node();
+		t2->_left = NULL;
+		t2->_right = NULL;
+		try
+		{
+			_run_sides(exec, op, tasks, l2, r2, h2 - (t2->_color == black), h1, drop, threads);
+		}
+		catch (...)
+		{
+			drop.push(t2);
+			if (found != NULL)
+				drop.push(found);
+			throw ;
+		}
+		if (found != NULL)
+			drop.push(t2);
 		else
-			y->_right = z;
-		z->_left = _head._null;
-		z->_right = _head._null;
-		z->_color = red;
-		_rb_tree_color_fixup(z);
-		return (z);
+			found = t2;
+		return (_join(tasks[0].result, tasks[0].h, found, tasks[1].result, tasks[1].h, h));
 	}
 
-	void	_rb_tree_color_fixup(node_ptr z)
+	// the intersection and the difference, which only read t2
+	template <typename Execution>
+	base_ptr	_set_operation(const Execution& exec, _set_op op, base_ptr t1, size_type h1,
+		const rb_node_base* t2, size_type h2, size_type& h, _drop_list& drop, size_type threads)
 	{
-		node_ptr	y;
+		base_ptr										found;
+		_set_op_task<Execution, const rb_node_base*>	tasks[2];
 
-		while (z->_p->_color == red)
+		if (t1 == NULL || t2 == NULL)
 		{
-			if (z->_p == z->_p->_p->_left)
+			if (op == _set_intersection && t1 != NULL)
 			{
-				y = z->_p->_p->_right;		
-				if (y->_color == red)
-				{
-					z->_p->_color = black;
-					y->_color = black;
-					z->_p->_p->_color = red;
-					z = z->_p->_p;
-				}
-				else
-				{
-					if (z == z->_p->_right)
-					{
-						z = z->_p;
-						_left_rotate(z);
-					}
-					z->_p->_color = black;
-					z->_p->_p->_color = red;
-					_right_rotate(z->_p->_p);
-				}
+				drop.push(t1);
+				t1 = NULL;
+				h1 = 0;
 			}
+			h = h1;
+			return (t1);
+		}
+		try
+		{
+			_split(t1, h1, _key(t2), tasks[0].t1, tasks[0].h1, tasks[1].t1, tasks[1].h1, &found);
+		}
+		catch (...)
+		{
+			drop.push(t1);
+			throw ;
+		}
+		try
+		{
+			_run_sides(exec, op, tasks, static_cast<const rb_node_base*>(t2->_left),
+				static_cast<const rb_node_base*>(t2->_right), h2 - (t2->_color == black), h1, drop,
+				threads);
+		}
+		catch (...)
+		{
+			if (found != NULL)
+				drop.push(found);
+			throw ;
+		}
+		if (op == _set_difference && found != NULL)
+		{
+			drop.push(found);
+			found = NULL;
+		}
+		if (found != NULL)
+			return (_join(tasks[0].result, tasks[0].h, found, tasks[1].result, tasks[1].h, h));
+		return (_join2(tasks[0].result, tasks[0].h, tasks[1].result, tasks[1].h, h));
+	}
+
+	// processes both sides of t1, split by the root of t2, with the matching
+	// children l2 and r2 of black height ch: on two threads when there are
+	// threads to spare and the subtrees are large enough. when a side
+	// throws, everything the tasks hold, done or not, is put on drop
+	template <typename Execution, typename NodePtr>
+	void	_run_sides(const Execution& exec, _set_op op, _set_op_task<Execution, NodePtr>* tasks,
+		NodePtr l2, NodePtr r2, size_type ch, size_type h1, _drop_list& drop, size_type threads)
+	{
+		for (size_type i = 0; i < 2; i++)
+		{
+			tasks[i].tree = this;
+			tasks[i].exec = &exec;
+			tasks[i].op = op;
+			tasks[i].t2 = (i == 0) ? l2 : r2;
+			tasks[i].h2 = ch;
+			tasks[i].threads = (i == 0) ? threads / 2 : threads - threads / 2;
+			tasks[i].result = NULL;
+			tasks[i].drop.first = NULL;
+			tasks[i].drop.last = NULL;
+		}
+		try
+		{
+			if (threads > 1 && ch >= _parallel_black_height && h1 >= _parallel_black_height)
+				exec.run(tasks, 2);
 			else
 			{
-				y = z->_p->_p->_left;
-				if (y->_color == red)
-				{
-					z->_p->_color = black;
-					y->_color = black;
-					z->_p->_p->_color = red;
-					z = z->_p->_p;
-				}
-				else
-				{
-					if (z == z->_p->_left)
-					{
-						z = z->_p;
-						_right_rotate(z);
-					}
-					z->_p->_color = black;
-					z->_p->_p->_color = red;
-					_left_rotate(z->_p->_p);
-				}
+				tasks[0].threads = 1;
+				tasks[1].threads = 1;
+				tasks[0]();
+				tasks[1]();
 			}
 		}
-		_head._root->_color = black;
+		catch (...)
+		{
+			for (size_type i = 0; i < 2; i++)
+			{
+				if (tasks[i].t1 != NULL)
+					drop.push(tasks[i].t1);
+				_drop_owned(drop, tasks[i].t2);
+				if (tasks[i].result != NULL)
+					drop.push(tasks[i].result);
+				drop.append(tasks[i].drop);
+			}
+			throw ;
+		}
+		drop.append(tasks[0].drop);
+		drop.append(tasks[1].drop);
+	}
+
+	// runs the union on the whole trees: every node of other is taken
+	template <typename Execution>
+	void	_run_union(rb_tree& other, const Execution& exec)
+	{
+		_drop_list	drop;
+		base_ptr	t1 = _head._root;
+		base_ptr	t2 = other._head._root;
+		size_type	h;
+		size_type	size = _head._size + other._head._size;
+
+		drop.first = NULL;
+		drop.last = NULL;
+		if (t1 != NULL)
+			t1->_p = _end_node();
+		if (t2 != NULL)
+			t2->_p = _end_node();
+		other._head.reset();
+		_head.reset();
+		try
+		{
+			t1 = _set_operation(exec, _set_union, t1, _black_height(t1), t2, _black_height(t2), h,
+				drop, exec.threads());
+		}
+		catch (...)
+		{
+			_install_set_result(NULL, 0, drop);
+			throw ;
+		}
+		_install_set_result(t1, size, drop);
 	}
 
-	// delete helper functions
+	// runs the intersection or the difference on the whole trees
+	template <typename Execution>
+	void	_run_filter(_set_op op, const rb_tree& other, const Execution& exec)
+	{
+		_drop_list			drop;
+		base_ptr			t1 = _head._root;
+		const rb_node_base*	t2 = other._head._root;
+		size_type			h;
+		size_type			size = _head._size;
+
+		drop.first = NULL;
+		drop.last = NULL;
+		if (t1 != NULL)
+			t1->_p = _end_node();
+		_head.reset();
+		try
+		{
+			t1 = _set_operation(exec, op, t1, _black_height(t1), t2, _black_height(t2), h, drop,
+				exec.threads());
+		}
+		catch (...)
+		{
+			_install_set_result(NULL, 0, drop);
+			throw ;
+		}
+		_install_set_result(t1, size, drop);
+	}
 
-	void	_rb_tree_delete(node_ptr z)
+	// frees the subtrees dropped by a set operation, out of size nodes,
+	// and makes its result x the whole tree
+	void	_install_set_result(base_ptr x, size_type size, _drop_list& drop)
 	{
-		node_ptr	x;
-		node_ptr	y = z;
-		enum rb_tree_color	y_orig_color = y->_color;
+		base_ptr	next;
 
-		if (z->_left == _head._null)
+		while (drop.first != NULL)
 		{
-			x = z->_right;
-			_transplant(z, z->_right);
+			next = drop.first->_p;
+			size -= _delete_all_nodes(drop.first);
+			drop.first = next;
 		}
-		else if (z->_right == _head._null)
+		_install(x, size);
+	}
+
+	// the number of nodes of l, out of the size nodes of the split trees
+	// l and r: the count of its root when every subtree is counted
+	size_type	_split_size(base_ptr l, base_ptr, size_type, ft::true_type) const
+	{
+		return (_subtree_count(l));
+	}
+
+	// otherwise, l from its first node and r from its last are walked in
+	// step until one of them ends, which only costs the smaller one. both
+	// roots have the null node as parent, where the walks stop
+	size_type	_split_size(base_ptr l, base_ptr r, size_type size, ft::false_type) const
+	{
+		base_ptr	x = (l == NULL) ? _end_node() : _tree_minimum(l);
+		base_ptr	y = (r == NULL) ? _end_node() : _tree_maximum(r);
+		size_type	n = 0;
+
+		while (x != _end_node() && y != _end_node())
 		{
-			x = z->_left;
-			_transplant(z, z->_left);
+			x = _rb_tree_successor(x);
+			y = _rb_tree_predecessor(y);
+			n++;
 		}
-		else
+		return ((x == _end_node()) ? n : size - n);
+	}
+
+	// makes the detached subtree x the whole tree
+	void	_install(base_ptr x, size_type size)
+	{
+		if (x == NULL)
 		{
-			y = _tree_minimum(z->_right);
-			y_orig_color = y->_color;
-			x = y->_right;
-			if (y->_p == z)
-				x->_p = y;
-			else
+			_head.reset();
+			return ;
+		}
+		_head._root = x;
+		x->_p = _end_node();
+		x->_color = black;
+		_head._begin = _tree_minimum(x);
+		_head._null._left = _tree_maximum(x);
+		_head._size = size;
+	}
+
+	// erases the nodes from first to last by splitting them out of the
+	// tree and joining what is left: O(k + log n) for k erased nodes.
+	// the splits follow the positions of first and last, no key is
+	// compared, so that nothing can throw
+	void	_erase_range(base_ptr first, base_ptr last)
+	{
+		base_ptr	path[128];
+		base_ptr	l = _head._root;
+		base_ptr	m;
+		base_ptr	r = NULL;
+		size_type	lh = _black_height(l);
+		size_type	mh;
+		size_type	rh = 0;
+		size_type	h;
+
+		if (last != _end_node())
+		{
+			_path_to(last, path);
+			_split_at(l, lh, path, last, l, lh, r, rh);
+		}
+		_path_to(first, path);
+		_split_at(l, lh, path, first, l, lh, m, mh);
+		_head._size -= _delete_all_nodes(m);
+		_install(_join2(l, lh, r, rh, h), _head._size);
+	}
+
+	// fills path with the nodes from the root of the tree holding x, which
+	// has the null node as parent, down to x. a red black tree is never
+	// deeper than twice the log2 of its size, so 128 entries are enough
+	static void	_path_to(base_ptr x, base_ptr* path)
+	{
+		size_type	n = 0;
+
+		for (base_ptr y = x; !_is_null_node(y); y = y->_p)
+			n++;
+		for (; n != 0; x = x->_p)
+			path[--n] = x;
+	}
+
+	// splits the subtree t of black height th at the node x: l gets the
+	// nodes before x, r x and the nodes after it, or only the nodes after
+	// it when found is given, x then being returned in it, detached. path
+	// holds the nodes from t down to x, so the side of every node along
+	// it is known without a comparison. the nodes along the path are
+	// joined back onto either side as the recursion unwinds: the heights
+	// of the joined trees grow along the path, so that the joins add up
+	// to O(log n)
+	void	_split_at(base_ptr t, size_type th, base_ptr const* path, base_ptr x,
+		base_ptr& l, size_type& lh, base_ptr& r, size_type& rh, base_ptr* found = NULL)
+	{
+		base_ptr	left = t->_left;
+		base_ptr	right = t->_right;
+		base_ptr	mid;
+		size_type	mid_h;
+		size_type	ch = th - (t->_color == black);
+
+		if (left != NULL)
+			left->_p = _end_node();
+		if (right != NULL)
+			right->_p = _end_node();
+		if (t == x)
+		{
+			l = left;
+			lh = ch;
+			if (found == NULL)
 			{
-				_transplant(y, y->_right);
-				y->_right = z->_right;
-				y->_right->_p = y;
+				r = _join(NULL, 0, t, right, ch, rh);
+				return ;
 			}
-			_transplant(z, y);
-			y->_left = z->_left;
-			y->_left->_p = y;
-			y->_color = z->_color;
+			r = right;
+			rh = ch;
+			t->_left = NULL;
+			t->_right = NULL;
+			t->_p = _end_node();
+			*found = t;
 		}
-		if (y_orig_color == black)
-			_rb_delete_fixup(x);
+		else if (path[1] == left)
+		{
+			_split_at(left, ch, path + 1, x, l, lh, mid, mid_h, found);
+			r = _join(mid, mid_h, t, right, ch, rh);
+		}
+		else
+		{
+			_split_at(right, ch, path + 1, x, mid, mid_h, r, rh, found);
+			l = _join(left, ch, t, mid, mid_h, lh);
+		}
+	}
+
+	// allocate/deallocate
+
+	node_ptr	_get_node(const Key& key, const T& val)
+	{
+		node_ptr	ret = _alloc.allocate(1);
+
+		_construct_node(ret, key, val);
+		return (ret);
+	}
+
+	// the node is built in place: going through the allocator's construct
+	// would build a whole temporary node and copy it, key and value included.
+	// the memory goes back to the allocator if key or value throws
+	void	_construct_node(node_ptr node, const Key& key, const T& val)
+	{
+		try
+		{
+			Augment::construct(__builtin_addressof(*node), key, val);
+		}
+		catch (...)
+		{
+			_alloc.deallocate(node, 1);
+			throw ;
+		}
+	}
+
+	void	_delete_node(base_ptr x)
+	{
+		if (x != NULL)
+		{
+			node_ptr	node = static_cast<node_ptr>(x);
+
+			_destroy_node(node, typename ft::is_trivially_destructible<node_type>::type());
+			_alloc.deallocate(__builtin_addressof(*node), 1);
+		}
+	}
+
+	// nothing to run for nodes whose key and value have trivial destructors
+	void	_destroy_node(node_ptr, ft::true_type)
+	{ }
+
+	void	_destroy_node(node_ptr node, ft::false_type)
+	{
+		_alloc.destroy(__builtin_addressof(*node));
 	}
 
-	void	_rb_delete_fixup(node_ptr x)
+	// frees a whole subtree and counts its nodes without recursion, keeping the pending
+	// subtrees on a fixed stack: the height of a red black tree never
+	// exceeds twice the log2 of its size, so 128 entries are enough
+	size_type	_delete_all_nodes(base_ptr x)
 	{
-		node_ptr	w;
+		base_ptr	stack[128];
+		size_type	top = 0;
+		size_type	count = 0;
 
-		while (x != _head._root && x->_color == black)
+		if (x == NULL)
+			return (0);
+		stack[top++] = x;
+		while (top != 0)
 		{
-			if (x == x->_p->_left)
+			x = stack[--top];
+			if (x->_right != NULL)
 			{
-				w = x->_p->_right;
-				if (w->_color == red)
-				{
-					w->_color = black;
-					x->_p->_color = red;
-					_left_rotate(x->_p);
-					w = x->_p->_right;
-				}
-				if (w->_left->_color == black && w->_right->_color == black)
-				{
-					w->_color = red;
-					x = x->_p;
-				}
-				else
-				{
-					if (w->_right->_color == black)
-					{
-						w->_left->_color = black;
-						w->_color = red;
-						_right_rotate(w);
-						w = x->_p->_right;
-					}
-					w->_color = x->_p->_color;
-					x->_p->_color = black;
-					w->_right->_color = black;
-					_left_rotate(x->_p);
-					x = _head._root;
-				}
+				__builtin_prefetch(x->_right);
+				stack[top++] = x->_right;
 			}
-			else
+			if (x->_left != NULL)
 			{
-				w = x->_p->_left;
-				if (w->_color == red)
-				{
-					w->_color = black;
-					x->_p->_color = red;
-					_right_rotate(x->_p);
-					w = x->_p->_left;
-				}
-				if (w->_right->_color == black && w->_left->_color == black)
-				{
-					w->_color = red;
-					x = x->_p;
-				}
-				else
-				{
-					if (w->_left->_color == black)
-					{
-						w->_right->_color = black;
-						w->_color = red;
-						_left_rotate(w);
-						w = x->_p->_left;
-					}
-					w->_color = x->_p->_color;
-					x->_p->_color = black;
-					w->_left->_color = black;
-					_right_rotate(x->_p);
-					x = _head._root;
-				}
+				__builtin_prefetch(x->_left);
+				stack[top++] = x->_left;
 			}
+			_delete_node(x);
+			count++;
 		}
-		x->_color = black;
+		return (count);
 	}
-				
 
-	void	_transplant(node_ptr u, node_ptr v)
+	// reuse is a list of spare nodes chained through _right, ended by NULL:
+	// they are taken first, then nodes are allocated
+	node_ptr	_reuse_or_get_node(base_ptr& reuse, const Key& key, const T& val)
 	{
-		if (u->_p == _head._null)
-			_head._root = v;
-		else if (u == u->_p->_left)
-			u->_p->_left = v;
-		else
-			u->_p->_right = v;
-		v->_p = u->_p;
+		node_ptr	ret;
+
+		if (reuse == NULL)
+			return (_get_node(key, val));
+		ret = static_cast<node_ptr>(reuse);
+		reuse = reuse->_right;
+		_destroy_node(ret, typename ft::is_trivially_destructible<node_type>::type());
+		_construct_node(ret, key, val);
+		return (ret);
 	}
 
-	void	_left_rotate(node_ptr x)
+	void	_delete_list(base_ptr list)
 	{
-		node_ptr	y = x->_right;
+		base_ptr	next;
 
-		x->_right = y->_left;
-		if (y->_left != _head._null)
-			y->_left->_p = x;
-		y->_p = x->_p;
-		// these 3 conditions replace x by y in x's former parent
-		if (x->_p == _head._null)
-			_head._root = y;		else if (x == x->_p->_left)
-			x->_p->_left = y;
-		else
-			x->_p->_right = y;
-		y->_left = x;
-		x->_p = y;
+		while (list != NULL)
+		{
+			next = list->_right;
+			_delete_node(list);
+			list = next;
+		}
 	}
 
-	void	_right_rotate(node_ptr y)
+	// unlinks every node of the subtree into a list chained through _right:
+	// a node with a left child is rotated right until it has none, then
+	// moved to the list, so no stack is needed
+	base_ptr	_flatten(base_ptr x)
 	{
-		node_ptr	x = y->_left;
+		base_ptr	list = NULL;
+		base_ptr	y;
 
-		y->_left = x->_right;
-		if (x->_right != _head._null)
-			x->_right->_p = y;
-		x->_p = y->_p;
-		if (y->_p == _head._null)
-			_head._root = x;
-		else if (y == y->_p->_left)
-			y->_p->_left = x;
-		else
-			y->_p->_right = x;
-		x->_right = y;
-		y->_p = x;
+		while (x != NULL)
+		{
+			if (x->_left != NULL)
+			{
+				y = x->_left;
+				x->_left = y->_right;
+				y->_right = x;
+				x = y;
+			}
+			else
+			{
+				y = x->_right;
+				x->_right = list;
+				list = x;
+				x = y;
+			}
+		}
+		return (list);
 	}
 
-	// allocate/deallocate
+	// structural copy of an empty tree from another one: the shape and the
+	// colors are cloned node for node, so no key is ever compared.
+	// if a copy throws, the nodes cloned so far and the spare nodes left
+	// in reuse are freed, and the tree is left empty
+	void	_copy_tree(const rb_tree& from, base_ptr& reuse)
+	{
+		if (from._head._root == NULL)
+			return ;
+		try
+		{
+			_head._root = _clone_node(from._head._root, _end_node(), reuse);
+			_copy_children(from._head._root, _head._root, reuse);
+		}
+		catch (...)
+		{
+			_delete_all_nodes(_head._root);
+			_head.reset();
+			_delete_list(reuse);
+			reuse = NULL;
+			throw ;
+		}
+		_head._begin = _tree_minimum(_head._root);
+		_head._null._left = _tree_maximum(_head._root);
+		_head._size = from._head._size;
+	}
 
-	node_ptr	_get_node(const Key& key, const T& val)
+	// clones the children of x under y, the clone of x. every clone is
+	// linked as soon as it is built, so that the copy is always a tree
+	// that can be freed. recurses on right children and loops on left
+	// ones, so the recursion depth is bounded by the height of the tree
+	void	_copy_children(const rb_node_base* x, base_ptr y, base_ptr& reuse)
 	{
-		node_ptr	ret = _alloc.allocate(1);
-		_alloc.construct(__builtin_addressof(*ret), rb_node<Key, T>(key, val, _head._null));
+		while (true)
+		{
+			if (x->_right)
+			{
+				y->_right = _clone_node(x->_right, y, reuse);
+				_copy_children(x->_right, y->_right, reuse);
+			}
+			x = x->_left;
+			if (x == NULL)
+				return ;
+			y->_left = _clone_node(x, y, reuse);
+			y = y->_left;
+		}
+	}
+
+	// a leaf of parent, for now
+	base_ptr	_clone_node(const rb_node_base* x, base_ptr parent, base_ptr& reuse)
+	{
+		const node_type*	from = static_cast<const node_type*>(x);
+		node_ptr			ret = _reuse_or_get_node(reuse, from->_key_val.first, from->_key_val.second);
+
+		ret->_p = parent;
+		ret->_left = NULL;
+		ret->_right = NULL;
+		ret->_color = x->_color;
+		Augment::copy(ret, from);
 		return (ret);
 	}
 
-	void	_delete_node(node_ptr x)
+	template <typename Iter>
+	void	_insert_range(Iter first, Iter last, std::input_iterator_tag)
+	{
+		while (first != last)
+		{
+			_insert_pos(end(), *first);
+			++first;
+		}
+	}
+
+	template <typename Iter>
+	void	_insert_range(Iter first, Iter last, std::forward_iterator_tag)
 	{
-		if (x != _head._null)
+		size_type	n = 0;
+
+		if (_head._root != NULL || !_is_strictly_sorted(first, last, n))
 		{
-			_alloc.destroy(__builtin_addressof(*x));
-			_alloc.deallocate(__builtin_addressof(*x), 1);
+			_insert_range(first, last, std::input_iterator_tag());
+			return ;
 		}
+		_build_tree(first, n);
 	}
 
-	void	_delete_all_nodes(node_ptr x)
+	// builds the whole tree, which must be empty, from the n elements of
+	// a strictly sorted range
+	template <typename Iter>
+	void	_build_tree(Iter first, size_type n)
 	{
-		if (x != _head._null)
+		size_type	red_depth = 0;
+
+		if (n == 0)
+			return ;
+		// the deepest level gets colored red unless the tree is perfect:
+		// every path then holds the same number of black nodes
+		while ((n >> (red_depth + 1)) != 0)
+			red_depth++;
+		if (((n + 1) & n) == 0)
+			red_depth = n;
+		_head._root = _build_sorted(first, n, 0, red_depth);
+		_head._root->_p = _end_node();
+		_head._begin = _tree_minimum(_head._root);
+		_head._null._left = _tree_maximum(_head._root);
+		_head._size = n;
+	}
+
+	// orders pairs by key, and tells apart the equivalent ones
+	struct _pair_less {
+		Compare	_comp;
+
+		bool	operator()(const pair_type& x, const pair_type& y) const
 		{
-			_delete_all_nodes(x->_left);
-			_delete_all_nodes(x->_right);
-			_delete_node(x);
+			return (_comp(x.first, y.first));
+		}
+	};
+
+	struct _pair_equiv {
+		Compare	_comp;
+
+		bool	operator()(const pair_type& x, const pair_type& y) const
+		{
+			return (!_comp(x.first, y.first) && !_comp(y.first, x.first));
+		}
+	};
+
+	// also counts the elements of the range in n
+	template <typename Iter>
+	bool	_is_strictly_sorted(Iter first, Iter last, size_type& n) const
+	{
+		Iter	prev = first;
+
+		if (first == last)
+			return (true);
+		n = 1;
+		while (++first != last)
+		{
+			if (!_comp((*prev).first, (*first).first))
+				return (false);
+			prev = first;
+			n++;
 		}
+		return (true);
 	}
 
+	// builds a balanced subtree from the next n elements of a sorted range:
+	// the middle element becomes the root of the subtree, the left half is
+	// built (and consumed from the range) first so first only moves forward.
+	// if a node cannot be built, the part of the subtree already built is
+	// freed, level by level as the exception goes up
 	template <typename Iter>
-	void	_rb_tree_copy_range(Iter first, Iter last)
+	base_ptr	_build_sorted(Iter& first, size_type n, size_type depth, size_type red_depth)
 	{
-		while (first != last)
+		base_ptr	x;
+		base_ptr	left;
+
+		if (n == 0)
+			return (NULL);
+		left = _build_sorted(first, (n - 1) / 2, depth + 1, red_depth);
+		try
 		{
-			_insert_pair(*first);
-			++first;
+			x = _get_node((*first).first, (*first).second);
+		}
+		catch (...)
+		{
+			_delete_all_nodes(left);
+			throw ;
+		}
+		++first;
+		x->_left = left;
+		if (left != NULL)
+			left->_p = x;
+		x->_right = NULL;
+		try
+		{
+			x->_right = _build_sorted(first, n - 1 - (n - 1) / 2, depth + 1, red_depth);
+		}
+		catch (...)
+		{
+			_delete_all_nodes(x);
+			throw ;
 		}
+		if (x->_right != NULL)
+			x->_right->_p = x;
+		x->_color = (depth == red_depth) ? red : black;
+		_update(x);
+		return (x);
 	}
 
 	// attributes
-	rb_tree_header<Key, T, node_allocator>	_head;
+	rb_tree_header	_head;
 	Compare			_comp;
 	node_allocator	_alloc;
 
@@ -1031,40 +2701,40 @@ class rb_tree
 
 // Comparison operators 
 
-template <typename Key, typename T, typename Compare, typename Allocator>
-bool	operator==(const rb_tree<Key, T, Compare, Allocator>& left, const rb_tree<Key, T, Compare, Allocator>& right)
+template <typename Key, typename T, typename Compare, typename Allocator, typename Augment>
+bool	operator==(const rb_tree<Key, T, Compare, Allocator, Augment>& left, const rb_tree<Key, T, Compare, Allocator, Augment>& right)
 {
 	if (left.size() != right.size())
 		return (false);
 	return (std::equal(left.begin(), left.end(), right.begin()));
 }
 
-template <typename Key, typename T, typename Compare, typename Allocator>
-bool	operator!=(const rb_tree<Key, T, Compare, Allocator>& left, const rb_tree<Key, T, Compare, Allocator>& right)
+template <typename Key, typename T, typename Compare, typename Allocator, typename Augment>
+bool	operator!=(const rb_tree<Key, T, Compare, Allocator, Augment>& left, const rb_tree<Key, T, Compare, Allocator, Augment>& right)
 {
 	return (!(left == right));
 }
 
-template <typename Key, typename T, typename Compare, typename Allocator>
-bool	operator<(const rb_tree<Key, T, Compare, Allocator>& left, const rb_tree<Key, T, Compare, Allocator>& right)
+template <typename Key, typename T, typename Compare, typename Allocator, typename Augment>
+bool	operator<(const rb_tree<Key, T, Compare, Allocator, Augment>& left, const rb_tree<Key, T, Compare, Allocator, Augment>& right)
 {
 	return (ft::lexicographical_compare(left.begin(), left.end(), right.begin(), right.end()));
 }
 
-template <typename Key, typename T, typename Compare, typename Allocator>
-bool	operator>=(const rb_tree<Key, T, Compare, Allocator>& left, const rb_tree<Key, T, Compare, Allocator>& right)
+template <typename Key, typename T, typename Compare, typename Allocator, typename Augment>
+bool	operator>=(const rb_tree<Key, T, Compare, Allocator, Augment>& left, const rb_tree<Key, T, Compare, Allocator, Augment>& right)
 {
 	return (!ft::lexicographical_compare(left.begin(), left.end(), right.begin(), right.end()));
 }
 
-template <typename Key, typename T, typename Compare, typename Allocator>
-bool	operator>(const rb_tree<Key, T, Compare, Allocator>& left, const rb_tree<Key, T, Compare, Allocator>& right)
+template <typename Key, typename T, typename Compare, typename Allocator, typename Augment>
+bool	operator>(const rb_tree<Key, T, Compare, Allocator, Augment>& left, const rb_tree<Key, T, Compare, Allocator, Augment>& right)
 {
 	return (ft::lexicographical_compare(right.begin(), right.end(), left.begin(), left.end()));
 }
 
-template <typename Key, typename T, typename Compare, typename Allocator>
-bool	operator<=(const rb_tree<Key, T, Compare, Allocator>& left, const rb_tree<Key, T, Compare, Allocator>& right)
+template <typename Key, typename T, typename Compare, typename Allocator, typename Augment>
+bool	operator<=(const rb_tree<Key, T, Compare, Allocator, Augment>& left, const rb_tree<Key, T, Compare, Allocator, Augment>& right)
 {
 	return (!ft::lexicographical_compare(right.begin(), right.end(), left.begin(), left.end()));
 }
@@ -0,0 +1,360 @@
+#ifndef RCU_MAP_HPP
+#define RCU_MAP_HPP
+
+#include <pthread.h>
+#include <memory>
+#include <functional>
+#include <cstddef>
+
+#include "persistent_map.hpp"
+#include "sharded_map.hpp"
+
+namespace ft {
+
+// map shared between threads, for lookups under rare updates (read copy
+// update). the map is a persistent_map: a writer changes its own version,
+// which copies only the path it changes, then publishes a snapshot of it
+// with one atomic store. a reader takes no lock and never retries: it
+// announces itself, reads the published version and leaves.
+// a version that was replaced is reclaimed once no reader can still be
+// in it. the readers are counted per epoch parity: the epoch only moves
+// on once the readers counted in the parity it moves to have left, and
+// a version retired in epoch e is freed once the epoch reached e + 2,
+// as every reader who could have seen it was counted in e or e + 1.
+// the reclamation is done by the writers, without waiting: the versions
+// that still have readers wait for the next write, reclaim() or the
+// destruction of the map.
+// writers are serialized by a mutex. the values are handed out by copy,
+// or through snapshot(), a persistent_map that is then read on its own.
+// Allocator is used by every thread: its copies have to be usable from
+// several threads at once, which pool_allocator is not
+template <class Key, class T, class Compare = std::less<Key>,
+		class Allocator = std::allocator<pair<const Key, T> > >
+class rcu_map {
+
+	public:
+		typedef Key									key_type;
+		typedef T									mapped_type;
+		typedef pair<const Key, T>					value_type;
+		typedef Compare								key_compare;
+		typedef Allocator							allocator_type;
+		typedef persistent_map<Key, T, Compare, Allocator>	snapshot_type;
+		typedef typename snapshot_type::size_type	size_type;
+
+	private:
+		// a published version, and the epoch it was retired in
+		struct _version {
+			_version(const snapshot_type& map) :
+				_map(map),
+				_epoch(0),
+				_next(NULL)
+				{ }
+
+			snapshot_type	_map;
+			size_t			_epoch;
+			_version*		_next;
+		};
+
+		typedef typename Allocator::template rebind<_version>::other	_version_allocator;
+
+	public:
+		// construct/destroy
+
+		explicit rcu_map(const Compare& comp = Compare(), const Allocator& alloc = Allocator()) :
+			_master(comp, alloc),
+			_retired(NULL),
+			_epoch(0),
+			_version_alloc(alloc)
+		{
+			for (size_t p = 0; p < 2; p++)
+			{
+				for (size_t i = 0; i < _stripes; i++)
+					_readers[p][i]._count = 0;
+			}
+			_current = _new_version(_version_alloc.allocate(1));
+			pthread_mutex_init(&_write_lock, NULL);
+		}
+
+		~rcu_map()
+		{
+			_free_versions(_retired);
+			_free_versions(_current);
+			pthread_mutex_destroy(&_write_lock);
+		}
+
+		// capacity
+
+		size_type	size(void) const
+		{
+			_reader	reader(*this);
+
+			return (reader._seen->_map.size());
+		}
+
+		bool	empty(void) const
+		{
+			return (size() == 0);
+		}
+
+		// lookup
+
+		// copies the value of k to value, which is left alone if k is missing
+		bool	find(const key_type& k, mapped_type& value) const
+		{
+			_reader								reader(*this);
+			typename snapshot_type::const_iterator	it = reader._seen->_map.find(k);
+
+			if (it == reader._seen->_map.end())
+				return (false);
+			value = it->second;
+			return (true);
+		}
+
+		size_type	count(const key_type& k) const
+		{
+			_reader	reader(*this);
+
+			return (reader._seen->_map.count(k));
+		}
+
+		// the published version, in O(1): it is read with no further
+		// synchronisation, and later writes do not change it
+		snapshot_type	snapshot(void) const
+		{
+			_reader	reader(*this);
+
+			return (reader._seen->_map);
+		}
+
+		// modifiers
+
+		// each write publishes a version of its own. a write that throws
+		// leaves both the map and the published version as they were
+
+		bool	insert(const value_type& x)
+		{
+			_writer	writer(*this);
+
+			return (writer.publish(_master.insert(x).second));
+		}
+
+		// true when k was inserted, false when its value was assigned
+		bool	insert_or_assign(const key_type& k, const mapped_type& obj)
+		{
+			_writer	writer(*this);
+
+			return (writer.publish(_master.insert_or_assign(k, obj).second, true));
+		}
+
+		size_type	erase(const key_type& k)
+		{
+			_writer	writer(*this);
+
+			return (writer.publish(_master.erase(k)));
+		}
+
+		void	clear(void)
+		{
+			_writer	writer(*this);
+
+			_master.clear();
+			writer.publish(true);
+		}
+
+		// calls f on the writers' version, a snapshot_type, and publishes
+		// all its changes at once. if f throws, none of them is published
+		template <class Function>
+		void	update(Function f)
+		{
+			_writer	writer(*this);
+
+			f(_master);
+			writer.publish(true);
+		}
+
+		// frees the retired versions that no reader can still be in
+		void	reclaim(void)
+		{
+			pthread_mutex_lock(&_write_lock);
+			_reclaim();
+			pthread_mutex_unlock(&_write_lock);
+		}
+
+		// observers
+
+		key_compare	key_comp(void) const
+		{
+			return (_master.key_comp());
+		}
+
+		allocator_type	get_allocator(void) const
+		{
+			return (_master.get_allocator());
+		}
+
+	private:
+		// the readers of a parity are counted over that many cache lines,
+		// picked from their thread, so that readers do not all write the
+		// same one
+		enum { _stripes = 16 };
+
+		struct _reader_count {
+			size_t	_count;
+			char	_pad[64 - sizeof(size_t)];
+		};
+
+		// a reader for the time it lives: counted in the parity of the
+		// epoch it saw, before it reads the published version. a reader
+		// slow to count itself, in a parity the epoch has left since, reads
+		// a version retired after it was counted: the next two moves of the
+		// epoch wait for it
+		struct _reader {
+			_reader(const rcu_map& m) :
+				_count(&m._readers[__atomic_load_n(&m._epoch, __ATOMIC_SEQ_CST) % 2][_stripe()]._count)
+			{
+				__atomic_add_fetch(_count, 1, __ATOMIC_SEQ_CST);
+				_seen = __atomic_load_n(&m._current, __ATOMIC_SEQ_CST);
+			}
+
+			~_reader()
+			{
+				__atomic_sub_fetch(_count, 1, __ATOMIC_RELEASE);
+			}
+
+			static size_t	_stripe(void)
+			{
+				return (shard_hash<unsigned long>()(pthread_self()) % _stripes);
+			}
+
+			size_t*			_count;
+			const _version*	_seen;
+		};
+
+		// holds the write lock, with a version allocated up front so that
+		// publishing cannot fail. a writer that did not publish puts the
+		// writers' version back as the published one
+		struct _writer {
+			_writer(rcu_map& m) :
+				_m(m),
+				_raw(NULL),
+				_published(false)
+			{
+				pthread_mutex_lock(&_m._write_lock);
+				try
+				{
+					_raw = _m._version_alloc.allocate(1);
+				}
+				catch (...)
+				{
+					pthread_mutex_unlock(&_m._write_lock);
+					throw ;
+				}
+			}
+
+			~_writer()
+			{
+				if (!_published)
+					_m._master = _m._current->_map;
+				if (_raw != NULL)
+					_m._version_alloc.deallocate(_raw, 1);
+				pthread_mutex_unlock(&_m._write_lock);
+			}
+
+			// publishes the writers' version when changed, and returns it
+			template <typename Result>
+			Result	publish(Result changed, bool force = false)
+			{
+				_published = true;
+				if (changed || force)
+				{
+					_m._publish(_m._new_version(_raw));
+					_raw = NULL;
+				}
+				return (changed);
+			}
+
+			rcu_map&	_m;
+			_version*	_raw;
+			bool		_published;
+		};
+
+		_version*	_new_version(_version* raw)
+		{
+			_version_alloc.construct(raw, _version(_master));
+			return (raw);
+		}
+
+		void	_free_versions(_version* v)
+		{
+			_version*	next;
+
+			for (; v != NULL; v = next)
+			{
+				next = v->_next;
+				_version_alloc.destroy(v);
+				_version_alloc.deallocate(v, 1);
+			}
+		}
+
+		// under the write lock
+		void	_publish(_version* v)
+		{
+			_version*	old = __atomic_exchange_n(&_current, v, __ATOMIC_SEQ_CST);
+
+			old->_epoch = _epoch;
+			old->_next = _retired;
+			_retired = old;
+			_reclaim();
+		}
+
+		bool	_drained(size_t parity) const
+		{
+			for (size_t i = 0; i < _stripes; i++)
+			{
+				if (__atomic_load_n(&_readers[parity][i]._count, __ATOMIC_SEQ_CST) != 0)
+					return (false);
+			}
+			return (true);
+		}
+
+		// moves the epoch on as far as the readers let it, at most twice,
+		// then frees the versions retired two epochs ago or earlier
+		void	_reclaim(void)
+		{
+			_version**	link = &_retired;
+			_version*	v;
+
+			for (size_t i = 0; i < 2 && _retired != NULL && _drained((_epoch + 1) % 2); i++)
+				__atomic_store_n(&_epoch, _epoch + 1, __ATOMIC_SEQ_CST);
+			while (*link != NULL)
+			{
+				v = *link;
+				if (v->_epoch + 2 <= _epoch)
+				{
+					*link = v->_next;
+					v->_next = NULL;
+					_free_versions(v);
+				}
+				else
+					link = &v->_next;
+			}
+		}
+
+		// shared between threads: not copyable
+		rcu_map(const rcu_map&);
+		rcu_map&	operator=(const rcu_map&);
+
+		// the writers' version, and the published one
+		snapshot_type		_master;
+		_version*			_current;
+		_version*			_retired;
+		size_t				_epoch;
+		// counted by the readers of a const map
+		mutable _reader_count	_readers[2][_stripes];
+		pthread_mutex_t		_write_lock;
+		_version_allocator	_version_alloc;
+};
+
+}
+
+#endif
@@ -0,0 +1,483 @@
+#ifndef SHARDED_MAP_HPP
+#define SHARDED_MAP_HPP
+
+#include <pthread.h>
+#include <memory>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <cstddef>
+
+#include "map.hpp"
+
+namespace ft {
+
+// the constants of the hashes below, for an unsigned long of 64 bits or,
+// where it only has 32, for their 32 bit versions. c++98 has no wider
+// type: the 64 bit constants are put together from halves
+template <bool Wide = (sizeof(unsigned long) >= 8)>
+struct shard_bits {
+
+	// the finalizer of murmur3
+	static unsigned long	mix(unsigned long x)
+	{
+		x ^= x >> 33;
+		x *= (0xff51afd7UL << 16 << 16) | 0xed558ccdUL;
+		x ^= x >> 33;
+		x *= (0xc4ceb9feUL << 16 << 16) | 0x1a85ec53UL;
+		x ^= x >> 33;
+		return (x);
+	}
+
+	// fnv-1a
+	static const unsigned long	fnv_basis = (0xcbf29ce4UL << 16 << 16) | 0x84222325UL;
+	static const unsigned long	fnv_prime = (0x100UL << 16 << 16) | 0x1b3UL;
+};
+
+template <>
+struct shard_bits<false> {
+
+	static unsigned long	mix(unsigned long x)
+	{
+		x ^= x >> 16;
+		x *= 0x85ebca6bUL;
+		x ^= x >> 13;
+		x *= 0xc2b2ae35UL;
+		x ^= x >> 16;
+		return (x);
+	}
+
+	static const unsigned long	fnv_basis = 0x811c9dc5UL;
+	static const unsigned long	fnv_prime = 0x01000193UL;
+};
+
+// hash used to pick the shard of a key. the integral keys go through
+// the finalizer of murmur3, so that keys that follow each other do not
+// pile up in the same shards
+template <typename Key>
+struct shard_hash {
+
+	size_t	operator()(const Key& k) const
+	{
+		return (static_cast<size_t>(shard_bits<>::mix(static_cast<unsigned long>(k))));
+	}
+};
+
+// fnv-1a
+template <>
+struct shard_hash<std::string> {
+
+	size_t	operator()(const std::string& k) const
+	{
+		unsigned long	x = shard_bits<>::fnv_basis;
+
+		for (size_t i = 0; i < k.size(); i++)
+		{
+			x ^= static_cast<unsigned char>(k[i]);
+			x *= shard_bits<>::fnv_prime;
+		}
+		return (static_cast<size_t>(x));
+	}
+};
+
+// walks N sorted ranges of pairs, with distinct keys, as one sorted
+// range: every step takes the range whose next key is the lowest
+template <typename Iterator, typename Compare, size_t N>
+struct	merge_iterator
+{
+	typedef typename ft::iterator_traits<Iterator>::value_type	value_type;
+	typedef typename ft::iterator_traits<Iterator>::reference	reference;
+	typedef typename ft::iterator_traits<Iterator>::pointer		pointer;
+	typedef std::forward_iterator_tag	iterator_category;
+	typedef ptrdiff_t	difference_type;
+
+	typedef merge_iterator<Iterator, Compare, N>	self;
+
+	public:
+
+	// constructors/destructor
+
+	// the end of the merge
+	merge_iterator() :
+		_top(N)
+		{ }
+
+	merge_iterator(const Iterator* first, const Iterator* last, const Compare& comp) :
+		_top(N),
+		_comp(comp)
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			_cur[i] = first[i];
+			_end[i] = last[i];
+		}
+		_select();
+	}
+
+	// iterator requirements
+
+	reference	operator*(void) const
+	{
+		return (*_cur[_top]);
+	}
+
+	self&	operator++(void)
+	{
+		++_cur[_top];
+		_select();
+		return (*this);
+	}
+
+	// input iterator requirements
+
+	pointer	operator->(void) const
+	{
+		return (&*_cur[_top]);
+	}
+
+	self	operator++(int)
+	{
+		self	tmp = *this;
+
+		++*this;
+		return (tmp);
+	}
+
+	friend bool	operator==(const self& x, const self& y)
+	{
+		return (x._top == y._top && (x._top == N || x._cur[x._top] == y._cur[y._top]));
+	}
+
+	friend bool	operator!=(const self& x, const self& y)
+	{
+		return (!(x == y));
+	}
+
+	private:
+	// a linear scan of the heads: N is the small number of shards
+	void	_select(void)
+	{
+		_top = N;
+		for (size_t i = 0; i < N; i++)
+		{
+			if (_cur[i] != _end[i] && (_top == N || _comp(_cur[i]->first, _cur[_top]->first)))
+				_top = i;
+		}
+	}
+
+	Iterator	_cur[N];
+	Iterator	_end[N];
+	size_t		_top;
+	Compare		_comp;
+};
+
+// map split by the hash of its keys into Shards maps, each behind a
+// mutex of its own, so that threads working on different shards do
+// not wait for each other. the lookups and operator[] hand out copies,
+// update changes a value in place under the lock of its shard.
+// a shard_view holds one shard and iterates it in order, an
+// ordered_view holds them all and iterates the whole map in order.
+// a thread holding a view must not call the map while it lives.
+// the shards copy the allocator: its copies have to be usable from
+// several threads at once, which pool_allocator is not
+template <class Key, class T, size_t Shards = 16, class Hash = shard_hash<Key>,
+		class Compare = std::less<Key>, class Allocator = std::allocator<pair<const Key, T> > >
+class sharded_map {
+
+	public:
+		typedef Key									key_type;
+		typedef T									mapped_type;
+		typedef pair<const Key, T>					value_type;
+		typedef Hash								hasher;
+		typedef Compare								key_compare;
+		typedef Allocator							allocator_type;
+		typedef map<Key, T, Compare, Allocator>		map_type;
+		typedef typename map_type::size_type		size_type;
+
+		// construct/destroy
+
+		explicit sharded_map(const Hash& hash = Hash(), const Compare& comp = Compare(),
+			const Allocator& alloc = Allocator()) :
+			_hash(hash),
+			_comp(comp)
+		{
+			for (size_t i = 0; i < Shards; i++)
+			{
+				map_type(comp, alloc).swap(_shards[i]._map);
+				pthread_mutex_init(&_shards[i]._lock, NULL);
+			}
+		}
+
+		~sharded_map()
+		{
+			for (size_t i = 0; i < Shards; i++)
+				pthread_mutex_destroy(&_shards[i]._lock);
+		}
+
+		// capacity
+
+		// the shards are counted one after the other, while the others
+		// may change
+		size_type	size(void) const
+		{
+			size_type	n = 0;
+
+			for (size_t i = 0; i < Shards; i++)
+			{
+				_guard	guard(_shards[i]._lock);
+
+				n += _shards[i]._map.size();
+			}
+			return (n);
+		}
+
+		bool	empty(void) const
+		{
+			return (size() == 0);
+		}
+
+		// lookup
+
+		// copies the value of k to value, which is left alone if k is missing
+		bool	find(const key_type& k, mapped_type& value) const
+		{
+			_shard&								shard = _shard_of(k);
+			_guard								guard(shard._lock);
+			typename map_type::const_iterator	it = shard._map.find(k);
+
+			if (it == shard._map.end())
+				return (false);
+			value = it->second;
+			return (true);
+		}
+
+		size_type	count(const key_type& k) const
+		{
+			_shard&	shard = _shard_of(k);
+			_guard	guard(shard._lock);
+
+			return (shard._map.count(k));
+		}
+
+		// element access
+
+		// a copy of the value of k, inserted with a default value when missing
+		mapped_type	operator[](const key_type& k)
+		{
+			_shard&	shard = _shard_of(k);
+			_guard	guard(shard._lock);
+
+			return (shard._map[k]);
+		}
+
+		// calls f on the value of k, inserted with a default value when
+		// missing, under the lock of its shard: f must not call the map
+		template <class Function>
+		void	update(const key_type& k, Function f)
+		{
+			_shard&	shard = _shard_of(k);
+			_guard	guard(shard._lock);
+
+			f(shard._map[k]);
+		}
+
+		// modifiers
+
+		bool	insert(const value_type& x)
+		{
+			_shard&	shard = _shard_of(x.first);
+			_guard	guard(shard._lock);
+
+			return (shard._map.insert(x).second);
+		}
+
+		// true when k was inserted, false when its value was assigned
+		bool	insert_or_assign(const key_type& k, const mapped_type& obj)
+		{
+			_shard&	shard = _shard_of(k);
+			_guard	guard(shard._lock);
+
+			return (shard._map.insert_or_assign(k, obj).second);
+		}
+
+		size_type	erase(const key_type& k)
+		{
+			_shard&	shard = _shard_of(k);
+			_guard	guard(shard._lock);
+
+			return (shard._map.erase(k));
+		}
+
+		void	clear(void)
+		{
+			for (size_t i = 0; i < Shards; i++)
+			{
+				_guard	guard(_shards[i]._lock);
+
+				_shards[i]._map.clear();
+			}
+		}
+
+		// observers
+
+		size_type	shard_count(void) const
+		{
+			return (Shards);
+		}
+
+		size_type	shard_of(const key_type& k) const
+		{
+			return (_hash(k) % Shards);
+		}
+
+		hasher	hash_function(void) const
+		{
+			return (_hash);
+		}
+
+		key_compare	key_comp(void) const
+		{
+			return (_comp);
+		}
+
+	private:
+		// a map and its lock, padded so that the lock of the next shard
+		// is not on the same cache line
+		struct _shard {
+			pthread_mutex_t	_lock;
+			map_type		_map;
+			char			_pad[64];
+		};
+
+		struct _guard {
+			_guard(pthread_mutex_t& lock) : _lock(lock)
+			{
+				pthread_mutex_lock(&_lock);
+			}
+
+			~_guard()
+			{
+				pthread_mutex_unlock(&_lock);
+			}
+
+			pthread_mutex_t&	_lock;
+		};
+
+	public:
+		// views
+
+		// holds shard i, whose map is then used directly
+		class shard_view {
+
+			public:
+				typedef typename map_type::iterator	iterator;
+
+				shard_view(sharded_map& m, size_type i) :
+					_held(m._shards[i])
+				{
+					pthread_mutex_lock(&_held._lock);
+				}
+
+				~shard_view()
+				{
+					pthread_mutex_unlock(&_held._lock);
+				}
+
+				map_type&	get(void) const
+				{
+					return (_held._map);
+				}
+
+				iterator	begin(void) const
+				{
+					return (_held._map.begin());
+				}
+
+				iterator	end(void) const
+				{
+					return (_held._map.end());
+				}
+
+			private:
+				shard_view(const shard_view&);
+				shard_view&	operator=(const shard_view&);
+
+				_shard&	_held;
+		};
+
+		// holds every shard, taken in order so that two ordered views
+		// cannot deadlock, and merges them
+		class ordered_view {
+
+			public:
+				typedef merge_iterator<typename map_type::iterator, Compare, Shards>	iterator;
+
+				explicit ordered_view(sharded_map& m) :
+					_m(m)
+				{
+					for (size_t i = 0; i < Shards; i++)
+						pthread_mutex_lock(&_m._shards[i]._lock);
+				}
+
+				~ordered_view()
+				{
+					for (size_t i = Shards; i > 0; i--)
+						pthread_mutex_unlock(&_m._shards[i - 1]._lock);
+				}
+
+				iterator	begin(void) const
+				{
+					typename map_type::iterator	first[Shards];
+					typename map_type::iterator	last[Shards];
+
+					for (size_t i = 0; i < Shards; i++)
+					{
+						first[i] = _m._shards[i]._map.begin();
+						last[i] = _m._shards[i]._map.end();
+					}
+					return (iterator(first, last, _m._comp));
+				}
+
+				iterator	end(void) const
+				{
+					return (iterator());
+				}
+
+				size_type	size(void) const
+				{
+					size_type	n = 0;
+
+					for (size_t i = 0; i < Shards; i++)
+						n += _m._shards[i]._map.size();
+					return (n);
+				}
+
+			private:
+				ordered_view(const ordered_view&);
+				ordered_view&	operator=(const ordered_view&);
+
+				sharded_map&	_m;
+		};
+
+	private:
+		friend class	shard_view;
+		friend class	ordered_view;
+
+		// the shards are mutable: a lookup still takes the lock
+		_shard&	_shard_of(const key_type& k) const
+		{
+			return (_shards[shard_of(k)]);
+		}
+
+		// shared between threads: not copyable
+		sharded_map(const sharded_map&);
+		sharded_map&	operator=(const sharded_map&);
+
+		mutable _shard	_shards[Shards];
+		Hash			_hash;
+		Compare			_comp;
+};
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <pthread.h>
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include <cstddef>
+
+namespace ft {
+
+	// what a task run by run_parallel ended with: the exceptions do not
+	// cross threads, they are caught and thrown again by run_parallel
+	enum parallel_status { task_done, task_bad_alloc, task_failed };
+
+	template <typename Task>
+	struct parallel_slot {
+		Task*			_task;
+		parallel_status	_status;
+		pthread_t		_thread;
+		bool			_started;
+	};
+
+	template <typename Task>
+	void*	_run_parallel_slot(void* arg)
+	{
+		parallel_slot<Task>*	slot = static_cast<parallel_slot<Task>*>(arg);
+
+		try
+		{
+			(*slot->_task)();
+			slot->_status = task_done;
+		}
+		catch (std::bad_alloc&)
+		{
+			slot->_status = task_bad_alloc;
+		}
+		catch (...)
+		{
+			slot->_status = task_failed;
+		}
+		return (NULL);
+	}
+
+	// runs the n tasks, each on a thread of its own except the last one,
+	// which runs on the calling thread, as do the tasks that could not get
+	// a thread. returns once they are all done: if one of them threw,
+	// std::bad_alloc or std::runtime_error is thrown then
+	template <typename Task>
+	void	run_parallel(Task* tasks, size_t n)
+	{
+		std::vector<parallel_slot<Task> >	slots(n);
+		parallel_status						status = task_done;
+
+		for (size_t i = 0; i < n; i++)
+		{
+			slots[i]._task = tasks + i;
+			slots[i]._status = task_done;
+			slots[i]._started = (i + 1 < n && pthread_create(&slots[i]._thread,
+				NULL, _run_parallel_slot<Task>, &slots[i]) == 0);
+			if (!slots[i]._started)
+				_run_parallel_slot<Task>(&slots[i]);
+		}
+		for (size_t i = 0; i < n; i++)
+		{
+			if (slots[i]._started)
+				pthread_join(slots[i]._thread, NULL);
+			if (slots[i]._status > status)
+				status = slots[i]._status;
+		}
+		if (status == task_bad_alloc)
+			throw std::bad_alloc();
+		if (status == task_failed)
+			throw std::runtime_error("ft::run_parallel: a task failed");
+	}
+
+	// the two tasks of parallel_stable_sort: sorting a run (whose
+	// _middle is _last), merging two adjacent runs
+	template <typename RandomIt, typename Compare>
+	struct stable_sort_task {
+		RandomIt	_first;
+		RandomIt	_middle;
+		RandomIt	_last;
+		Compare		_comp;
+
+		void	operator()(void)
+		{
+			if (_middle == _last)
+				std::stable_sort(_first, _last, _comp);
+			else
+				std::inplace_merge(_first, _middle, _last, _comp);
+		}
+	};
+
+	// std::stable_sort on up to threads threads: the range is cut in
+	// runs sorted side by side, then merged two by two, each level of
+	// merges also in parallel. the last level is a single O(n) merge, on
+	// one thread. runs are kept above min_run elements
+	template <typename RandomIt, typename Compare>
+	void	parallel_stable_sort(RandomIt first, RandomIt last, Compare comp,
+		size_t threads, size_t min_run = 4096)
+	{
+		typedef stable_sort_task<RandomIt, Compare>	task_type;
+
+		size_t					n = std::distance(first, last);
+		size_t					runs = threads;
+		size_t					run;
+		std::vector<task_type>	tasks;
+		std::vector<size_t>		bounds;
+
+		if (runs > n / min_run)
+			runs = n / min_run;
+		if (runs <= 1)
+		{
+			std::stable_sort(first, last, comp);
+			return ;
+		}
+		run = n / runs;
+		for (size_t i = 0; i < runs; i++)
+			bounds.push_back(i * run);
+		bounds.push_back(n);
+		for (size_t i = 0; i < runs; i++)
+		{
+			task_type	t = { first + bounds[i], first + bounds[i + 1], first + bounds[i + 1], comp };
+
+			tasks.push_back(t);
+		}
+		run_parallel(&tasks[0], tasks.size());
+		// bounds[0..runs] delimit the sorted runs, halved at each level
+		while (runs > 1)
+		{
+			std::vector<size_t>	next;
+
+			tasks.clear();
+			for (size_t i = 0; i + 1 < runs; i += 2)
+			{
+				task_type	t = { first + bounds[i], first + bounds[i + 1], first + bounds[i + 2], comp };
+
+				tasks.push_back(t);
+				next.push_back(bounds[i]);
+			}
+			if (runs % 2 != 0)
+				next.push_back(bounds[runs - 1]);
+			next.push_back(n);
+			run_parallel(&tasks[0], tasks.size());
+			bounds.swap(next);
+			runs = bounds.size() - 1;
+		}
+	}
+
+	// runs the set algebra and the bulk construction of the maps on up to
+	// threads threads, where sequential_execution (see rb_tree.hpp) keeps
+	// them on the calling one. as with run_parallel, what a task throws
+	// is narrowed to std::bad_alloc or std::runtime_error
+	struct parallel_execution {
+
+		explicit parallel_execution(size_t threads) :
+			_threads((threads == 0) ? 1 : threads)
+			{ }
+
+		size_t	threads(void) const
+		{
+			return (_threads);
+		}
+
+		template <typename Task>
+		void	run(Task* tasks, size_t n) const
+		{
+			run_parallel(tasks, n);
+		}
+
+		template <typename RandomIt, typename Compare>
+		void	stable_sort(RandomIt first, RandomIt last, Compare comp) const
+		{
+			parallel_stable_sort(first, last, comp, _threads);
+		}
+
+		size_t	_threads;
+	};
+
+}
+
+#endif
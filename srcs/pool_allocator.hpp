@@ -0,0 +1,287 @@
+#ifndef POOL_ALLOCATOR_HPP
+#define POOL_ALLOCATOR_HPP
+
+#include <memory>
+#include <new>
+#include <cstddef>
+
+namespace ft {
+
+	// state shared by the copies of a pool_allocator: single objects are
+	// carved from blocks of growing size, freed objects go to a free list.
+	// when no object is in use, every block but the last, and largest, one
+	// is given back: a container cleared does not keep the memory of its
+	// peak, and one that keeps going from empty to a few objects and back
+	// does not go to operator new each time
+	template <typename T>
+	struct pool_state {
+
+		union slot {
+			slot*	_next;
+			char	_data[sizeof(T)];
+		};
+
+		struct block {
+			block*	_next;
+			size_t	_slots;
+		};
+
+		enum {
+			first_block_slots = 32,
+			max_block_slots = 4096,
+			// keeps the slots of a block aligned like operator new memory
+			header_size = (sizeof(block) + 15) & ~static_cast<size_t>(15)
+		};
+
+		pool_state(void) :
+			_refs(1),
+			_live(0),
+			_free(NULL),
+			_carve(NULL),
+			_carve_end(NULL),
+			_blocks(NULL),
+			_block_slots(first_block_slots)
+			{ }
+
+		~pool_state(void)
+		{
+			release();
+		}
+
+		T*	allocate(void)
+		{
+			slot*	ret;
+
+			if (_free)
+			{
+				ret = _free;
+				_free = _free->_next;
+			}
+			else
+			{
+				if (_carve == _carve_end)
+					_add_block();
+				ret = _carve++;
+			}
+			_live++;
+			return (reinterpret_cast<T*>(ret));
+		}
+
+		// the link to the next free slot overwrites the first word of the
+		// object: a store with release order, as concurrent_map has readers
+		// that may still load that word, the left link of a tree node
+		void	deallocate(T* p)
+		{
+			slot*	s = reinterpret_cast<slot*>(p);
+
+			__atomic_store_n(&s->_next, _free, __ATOMIC_RELEASE);
+			_free = s;
+			if (--_live == 0)
+				_trim();
+		}
+
+		// frees every block, whether its slots are in use or not
+		void	release(void)
+		{
+			block*	next;
+
+			while (_blocks)
+			{
+				next = _blocks->_next;
+				::operator delete(_blocks);
+				_blocks = next;
+			}
+			_live = 0;
+			_free = NULL;
+			_carve = NULL;
+			_carve_end = NULL;
+			_block_slots = first_block_slots;
+		}
+
+		// keeps the newest block, which is the largest, and carves it again
+		void	_trim(void)
+		{
+			block*	keep = _blocks;
+			block*	next;
+
+			for (block* b = keep->_next; b != NULL; b = next)
+			{
+				next = b->_next;
+				::operator delete(b);
+			}
+			keep->_next = NULL;
+			_free = NULL;
+			_carve = reinterpret_cast<slot*>(reinterpret_cast<char*>(keep) + header_size);
+			_carve_end = _carve + keep->_slots;
+		}
+
+		void	_add_block(void)
+		{
+			char*	raw = static_cast<char*>(::operator new(header_size + _block_slots * sizeof(slot)));
+			block*	b = reinterpret_cast<block*>(raw);
+
+			b->_next = _blocks;
+			b->_slots = _block_slots;
+			_blocks = b;
+			_carve = reinterpret_cast<slot*>(raw + header_size);
+			_carve_end = _carve + _block_slots;
+			if (_block_slots < max_block_slots)
+				_block_slots *= 2;
+		}
+
+		size_t	_refs;
+		size_t	_live;
+		slot*	_free;
+		slot*	_carve;
+		slot*	_carve_end;
+		block*	_blocks;
+		size_t	_block_slots;
+	};
+
+	// node allocator for the tree based containers: allocations of a single
+	// object come from a pool, larger ones go to operator new.
+	// copies of an allocator share its pool (and compare equal), a rebound
+	// allocator gets a pool of its own. the pool is only made when the
+	// allocator first allocates or is copied, so that the allocators
+	// rebound for a moment cost nothing.
+	// once a container is cleared, its pool still holds its largest block,
+	// at most max_block_slots objects, for the objects to come: the blocks
+	// all go back with the last copy of the allocator.
+	// making and sharing the pool is thread safe, so that copying the
+	// allocator of a const container does not race. the pool itself is
+	// not: containers copied from one another share it and must stay on
+	// one thread
+	template <typename T>
+	class pool_allocator {
+
+		public:
+			typedef T			value_type;
+			typedef T*			pointer;
+			typedef const T*	const_pointer;
+			typedef T&			reference;
+			typedef const T&	const_reference;
+			typedef size_t		size_type;
+			typedef ptrdiff_t	difference_type;
+
+			template <typename U>
+			struct rebind {
+				typedef pool_allocator<U>	other;
+			};
+
+			pool_allocator(void) :
+				_pool(NULL)
+				{ }
+
+			pool_allocator(const pool_allocator& from) :
+				_pool(from._shared())
+			{
+				__atomic_add_fetch(&_pool->_refs, 1, __ATOMIC_RELAXED);
+			}
+
+			template <typename U>
+			pool_allocator(const pool_allocator<U>&) :
+				_pool(NULL)
+				{ }
+
+			~pool_allocator(void)
+			{
+				_drop();
+			}
+
+			pool_allocator&	operator=(const pool_allocator& from)
+			{
+				pool_state<T>*	pool = from._shared();
+
+				__atomic_add_fetch(&pool->_refs, 1, __ATOMIC_RELAXED);
+				_drop();
+				_pool = pool;
+				return (*this);
+			}
+
+			pointer	address(reference x) const
+			{
+				return (__builtin_addressof(x));
+			}
+
+			const_pointer	address(const_reference x) const
+			{
+				return (__builtin_addressof(x));
+			}
+
+			pointer	allocate(size_type n, const void* hint = 0)
+			{
+				(void)hint;
+				if (n == 1)
+					return (_shared()->allocate());
+				return (static_cast<pointer>(::operator new(n * sizeof(T))));
+			}
+
+			void	deallocate(pointer p, size_type n)
+			{
+				if (n == 1)
+					_pool->deallocate(p);
+				else
+					::operator delete(p);
+			}
+
+			size_type	max_size(void) const
+			{
+				return (static_cast<size_type>(-1) / sizeof(T));
+			}
+
+			void	construct(pointer p, const T& val)
+			{
+				::new (static_cast<void*>(p)) T(val);
+			}
+
+			void	destroy(pointer p)
+			{
+				p->~T();
+			}
+
+			// an allocator without a pool yet will make its own: it only
+			// equals itself
+			friend bool	operator==(const pool_allocator& x, const pool_allocator& y)
+			{
+				pool_state<T>*	pool = __atomic_load_n(&x._pool, __ATOMIC_ACQUIRE);
+
+				return (pool == __atomic_load_n(&y._pool, __ATOMIC_ACQUIRE)
+					&& (pool != NULL || &x == &y));
+			}
+
+			friend bool	operator!=(const pool_allocator& x, const pool_allocator& y)
+			{
+				return (!(x == y));
+			}
+
+		private:
+			// the pool is made by whichever thread gets there first, the
+			// others give theirs back
+			pool_state<T>*	_shared(void) const
+			{
+				pool_state<T>*	pool = __atomic_load_n(&_pool, __ATOMIC_ACQUIRE);
+				pool_state<T>*	expected = NULL;
+
+				if (pool != NULL)
+					return (pool);
+				pool = new pool_state<T>();
+				if (__atomic_compare_exchange_n(&_pool, &expected, pool, false,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+					return (pool);
+				delete pool;
+				return (expected);
+			}
+
+			void	_drop(void)
+			{
+				if (_pool != NULL && __atomic_sub_fetch(&_pool->_refs, 1, __ATOMIC_ACQ_REL) == 0)
+					delete _pool;
+			}
+
+			// made by the first copy, by a const copied allocator too
+			mutable pool_state<T>*	_pool;
+	};
+
+}
+
+#endif
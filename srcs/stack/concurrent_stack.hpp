@@ -0,0 +1,398 @@
+#ifndef CONCURRENT_STACK_HPP
+#define CONCURRENT_STACK_HPP
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <cstddef>
+
+namespace ft {
+
+template <typename T>
+struct concurrent_stack_node {
+
+	concurrent_stack_node(const T& x) :
+		_next(NULL),
+		_value(x)
+		{ }
+
+	concurrent_stack_node*	_next;
+	T						_value;
+};
+
+// the hazard pointers of one thread for the time of one pop, and the
+// nodes it popped that may still be read by others. the records are
+// leased by the operations and only freed with the stack
+template <typename Node>
+struct hazard_record {
+
+	hazard_record() :
+		_active(1),
+		_next(NULL),
+		_retired(NULL),
+		_retired_count(0)
+	{
+		_hazards[0] = NULL;
+		_hazards[1] = NULL;
+	}
+
+	Node*			_hazards[2];
+	int				_active;
+	hazard_record*	_next;
+	Node*			_retired;
+	size_t			_retired_count;
+	// keeps the hazards of two records off the same cache line
+	char			_pad[64];
+};
+
+// lock-free stack shared between threads (Treiber): a list whose top
+// is swung by compare and swap. a popped node is only freed once no
+// thread holds a hazard pointer to it, so that a node cannot be read
+// after it was freed, nor come back at the same address under a pop
+// that read it (the ABA problem).
+// pop copies the value out: there is no top(). push_bulk and pop_bulk
+// move a whole chain with a single successful compare and swap. when
+// copying a popped value out throws, that value is lost.
+// Allocator is used by every thread: its copies have to be usable from
+// several threads at once, which pool_allocator is not
+template <class T, class Allocator = std::allocator<T> >
+class concurrent_stack {
+
+	private:
+		typedef concurrent_stack_node<T>	_node;
+		typedef hazard_record<_node>		_record;
+		typedef typename Allocator::template rebind<_node>::other	_node_allocator;
+		typedef typename Allocator::template rebind<_record>::other	_record_allocator;
+
+	public:
+		typedef T									value_type;
+		typedef Allocator							allocator_type;
+		typedef size_t								size_type;
+
+		// construct/destroy
+
+		explicit concurrent_stack(const Allocator& alloc = Allocator()) :
+			_top(NULL),
+			_records(NULL),
+			_record_count(0),
+			_node_alloc(alloc),
+			_record_alloc(alloc)
+			{ }
+
+		~concurrent_stack()
+		{
+			_record*	next;
+
+			_free_chain(_top);
+			for (_record* r = _records; r != NULL; r = next)
+			{
+				next = r->_next;
+				_free_chain(r->_retired);
+				_record_alloc.destroy(r);
+				_record_alloc.deallocate(r, 1);
+			}
+		}
+
+		// capacity
+
+		bool	empty(void) const
+		{
+			return (__atomic_load_n(&_top, __ATOMIC_ACQUIRE) == NULL);
+		}
+
+		// modifiers
+
+		void	push(const value_type& x)
+		{
+			_node*	node = _create(x);
+
+			_link(node, node);
+		}
+
+		// pushes [first, last) in order, last one on top, as one push
+		template <class InputIterator>
+		void	push_bulk(InputIterator first, InputIterator last)
+		{
+			_node*	top = NULL;
+			_node*	bottom = NULL;
+			_node*	node;
+
+			try
+			{
+				for (; first != last; ++first)
+				{
+					node = _create(*first);
+					node->_next = top;
+					if (top == NULL)
+						bottom = node;
+					top = node;
+				}
+			}
+			catch (...)
+			{
+				_free_chain(top);
+				throw ;
+			}
+			if (top != NULL)
+				_link(top, bottom);
+		}
+
+		// copies the top value to value and removes it, false when empty
+		bool	pop(value_type& value)
+		{
+			return (pop_bulk(&value, 1) == 1);
+		}
+
+		// pops up to n values to out, top first, and returns their number
+		template <class OutputIterator>
+		size_type	pop_bulk(OutputIterator out, size_type n)
+		{
+			_record*	rec;
+			_node*		top;
+			_node*		next;
+			size_type	k;
+			size_type	i = 0;
+
+			if (n == 0)
+				return (0);
+			rec = _acquire();
+			top = _unlink(rec, n, k);
+			__atomic_store_n(&rec->_hazards[0], static_cast<_node*>(NULL), __ATOMIC_RELEASE);
+			__atomic_store_n(&rec->_hazards[1], static_cast<_node*>(NULL), __ATOMIC_RELEASE);
+			try
+			{
+				for (; i < k; i++, top = next)
+				{
+					next = top->_next;
+					*out = top->_value;
+					++out;
+					_retire(rec, top);
+				}
+			}
+			catch (...)
+			{
+				for (; i < k; i++, top = next)
+				{
+					next = top->_next;
+					_retire(rec, top);
+				}
+				_release(rec);
+				throw ;
+			}
+			_release(rec);
+			return (k);
+		}
+
+		// observers
+
+		allocator_type	get_allocator(void) const
+		{
+			return (allocator_type(_node_alloc));
+		}
+
+	private:
+		// a record scans its retired nodes once it holds twice as many as
+		// there are hazard pointers, plus that many, so that a scan frees
+		// most of them
+		enum { _min_scan = 64 };
+
+		_node*	_create(const value_type& x)
+		{
+			_node*	node = _node_alloc.allocate(1);
+
+			try
+			{
+				_node_alloc.construct(node, _node(x));
+			}
+			catch (...)
+			{
+				_node_alloc.deallocate(node, 1);
+				throw ;
+			}
+			return (node);
+		}
+
+		void	_destroy(_node* node)
+		{
+			_node_alloc.destroy(node);
+			_node_alloc.deallocate(node, 1);
+		}
+
+		void	_free_chain(_node* node)
+		{
+			_node*	next;
+
+			for (; node != NULL; node = next)
+			{
+				next = node->_next;
+				_destroy(node);
+			}
+		}
+
+		// puts the private chain top..bottom on the stack. a push reads no
+		// node but its own, so the nodes it sees come and go do not matter
+		void	_link(_node* top, _node* bottom)
+		{
+			_node*	old = __atomic_load_n(&_top, __ATOMIC_RELAXED);
+
+			do
+			{
+				__atomic_store_n(&bottom->_next, old, __ATOMIC_RELAXED);
+			}
+			while (!__atomic_compare_exchange_n(&_top, &old, top, true,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+		}
+
+		// points hazard i of rec at *from, until it is seen to still be there
+		_node*	_protect(_record* rec, int i, _node* const* from)
+		{
+			_node*	node = __atomic_load_n(from, __ATOMIC_ACQUIRE);
+			_node*	again;
+
+			while (true)
+			{
+				__atomic_store_n(&rec->_hazards[i], node, __ATOMIC_SEQ_CST);
+				again = __atomic_load_n(from, __ATOMIC_SEQ_CST);
+				if (again == node)
+					return (node);
+				node = again;
+			}
+		}
+
+		// detaches up to n nodes from the top, and returns the first with
+		// their number in k. hazard 0 holds the top, hazard 1 the node
+		// whose link is read. a popped node is never pushed again and
+		// cannot be freed while hazard 0 holds it, so as long as the top
+		// did not move, no node under it was popped either
+		_node*	_unlink(_record* rec, size_type n, size_type& k)
+		{
+			_node*	top;
+			_node*	last;
+			_node*	next;
+			bool	moved;
+
+			while (true)
+			{
+				top = _protect(rec, 0, &_top);
+				k = 0;
+				if (top == NULL)
+					return (NULL);
+				last = top;
+				moved = false;
+				for (k = 1; k < n && !moved; k++)
+				{
+					next = __atomic_load_n(&last->_next, __ATOMIC_RELAXED);
+					if (next == NULL)
+						break ;
+					__atomic_store_n(&rec->_hazards[1], next, __ATOMIC_SEQ_CST);
+					moved = (__atomic_load_n(&_top, __ATOMIC_SEQ_CST) != top);
+					last = next;
+				}
+				if (moved)
+					continue ;
+				next = __atomic_load_n(&last->_next, __ATOMIC_RELAXED);
+				if (__atomic_compare_exchange_n(&_top, &top, next, false,
+					__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+					return (top);
+			}
+		}
+
+		// the records are leased for one operation at a time
+		_record*	_acquire(void)
+		{
+			_record*	rec = __atomic_load_n(&_records, __ATOMIC_ACQUIRE);
+			int			idle;
+
+			for (; rec != NULL; rec = rec->_next)
+			{
+				idle = 0;
+				if (__atomic_load_n(&rec->_active, __ATOMIC_RELAXED) == 0
+					&& __atomic_compare_exchange_n(&rec->_active, &idle, 1, false,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+					return (rec);
+			}
+			rec = _record_alloc.allocate(1);
+			_record_alloc.construct(rec, _record());
+			rec->_next = __atomic_load_n(&_records, __ATOMIC_RELAXED);
+			while (!__atomic_compare_exchange_n(&_records, &rec->_next, rec, true,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+				;
+			__atomic_add_fetch(&_record_count, 1, __ATOMIC_RELAXED);
+			return (rec);
+		}
+
+		void	_release(_record* rec)
+		{
+			__atomic_store_n(&rec->_active, 0, __ATOMIC_RELEASE);
+		}
+
+		// the link of a retired node is reused for the retired list: a pop
+		// that still reads it fails its compare and swap anyway
+		void	_retire(_record* rec, _node* node)
+		{
+			__atomic_store_n(&node->_next, rec->_retired, __ATOMIC_RELAXED);
+			rec->_retired = node;
+			// two hazard pointers per record
+			if (++rec->_retired_count >= 2 * 2 * __atomic_load_n(&_record_count,
+				__ATOMIC_RELAXED) + _min_scan)
+				_scan(rec);
+		}
+
+		// frees the retired nodes of rec that no hazard pointer holds
+		void	_scan(_record* rec)
+		{
+			std::vector<_node*>	hazards;
+			_node*				node;
+			_node*				next;
+			_node*				kept = NULL;
+			size_t				count = 0;
+
+			// without memory for the hazards, the nodes wait for the next scan
+			try
+			{
+				for (_record* r = __atomic_load_n(&_records, __ATOMIC_ACQUIRE); r != NULL; r = r->_next)
+				{
+					for (int i = 0; i < 2; i++)
+					{
+						node = __atomic_load_n(&r->_hazards[i], __ATOMIC_SEQ_CST);
+						if (node != NULL)
+							hazards.push_back(node);
+					}
+				}
+			}
+			catch (std::bad_alloc&)
+			{
+				return ;
+			}
+			std::sort(hazards.begin(), hazards.end());
+			for (node = rec->_retired; node != NULL; node = next)
+			{
+				next = node->_next;
+				if (std::binary_search(hazards.begin(), hazards.end(), node))
+				{
+					__atomic_store_n(&node->_next, kept, __ATOMIC_RELAXED);
+					kept = node;
+					count++;
+				}
+				else
+					_destroy(node);
+			}
+			rec->_retired = kept;
+			rec->_retired_count = count;
+		}
+
+		// shared between threads: not copyable
+		concurrent_stack(const concurrent_stack&);
+		concurrent_stack&	operator=(const concurrent_stack&);
+
+		_node*				_top;
+		_record*			_records;
+		size_t				_record_count;
+		_node_allocator		_node_alloc;
+		_record_allocator	_record_alloc;
+};
+
+}
+
+#endif
@@ -90,6 +90,54 @@ namespace ft {
 		typedef true_type	type;
 	};
 
+	// bool_type
+	// maps a compile time condition to true_type or false_type
+	template <bool>
+	struct bool_type {
+		typedef false_type	type;
+	};
+
+	template <>
+	struct bool_type<true> {
+		typedef true_type	type;
+	};
+
+	// is_trivially_destructible
+	// relies on the compiler intrinsic (gcc and clang) as the
+	// property cannot be detected from within the language
+	template <typename T>
+	struct is_trivially_destructible {
+		enum { value = __has_trivial_destructor(T) };
+		typedef typename bool_type<(value != 0)>::type	type;
+	};
+
+	// is_transparent
+	// detects a comparator that declares an is_transparent member type,
+	// meaning that it can compare keys with values of other types
+	template <typename T>
+	struct is_transparent {
+		private:
+		typedef char	yes;
+		struct no { char _c[2]; };
+
+		template <typename U>
+		static yes	_test(typename U::is_transparent*);
+		template <typename U>
+		static no	_test(...);
+
+		public:
+		enum { value = (sizeof(_test<T>(0)) == sizeof(yes)) };
+		typedef typename bool_type<(value != 0)>::type	type;
+	};
+
+	// enable_if_transparent
+	// declares 'type' as R only for transparent comparators. K is the
+	// type of the looked up key: it makes the condition depend on the
+	// template parameter of the lookup function, so that the overload
+	// is discarded instead of making the whole class ill-formed
+	template <typename Compare, typename K, typename R>
+	struct enable_if_transparent : enable_if<is_transparent<Compare>::value, R> { };
+
 	// are_same trait
 	template <typename T1, typename T2>
 	struct are_same { 
@@ -0,0 +1,277 @@
+#ifndef CONCURRENT_VECTOR_HPP
+#define CONCURRENT_VECTOR_HPP
+
+#include <memory>
+#include <stdexcept>
+#include <cstring>
+#include <cstddef>
+
+namespace ft {
+
+// append-only vector shared between threads. the elements live in
+// segments that never move, each twice the size of the one before, so
+// that a reference to an element stays valid for the lifetime of the
+// vector while others append.
+// push_back reserves its index with a compare and swap on the number of
+// reserved slots and copies its value there. size() only counts the
+// prefix of the slots done, which every push_back moves forward as far
+// as it can: an index below size() can be read from any thread, without
+// a lock.
+// when copying a value throws, its slot is left as a hole that size()
+// goes past: at() throws std::out_of_range on it, operator[] must not
+// be used on it.
+// Allocator is used by every thread: its copies have to be usable from
+// several threads at once, which pool_allocator is not
+template <class T, class Allocator = std::allocator<T> >
+class concurrent_vector {
+
+	public:
+		typedef T									value_type;
+		typedef Allocator							allocator_type;
+		typedef typename Allocator::pointer			pointer;
+		typedef typename Allocator::reference		reference;
+		typedef typename Allocator::const_reference	const_reference;
+		typedef size_t								size_type;
+
+		// construct/destroy
+
+		explicit concurrent_vector(const Allocator& alloc = Allocator()) :
+			_reserved(0),
+			_size(0),
+			_alloc(alloc)
+		{
+			for (size_type k = 0; k < _max_segments; k++)
+				_segments[k] = pointer();
+		}
+
+		~concurrent_vector()
+		{
+			size_type	n;
+
+			for (size_type i = 0; i < _size; i++)
+			{
+				if (_state(i) != _hole)
+					_alloc.destroy(__builtin_addressof((*this)[i]));
+			}
+			for (size_type k = 0; k < _max_segments; k++)
+			{
+				if (_segments[k] == pointer())
+					continue ;
+				n = _segment_size(k);
+				_alloc.deallocate(_segments[k], n + _state_words(n));
+			}
+		}
+
+		// capacity
+
+		// the number of elements readable from any thread
+		size_type	size(void) const
+		{
+			return (__atomic_load_n(&_size, __ATOMIC_ACQUIRE));
+		}
+
+		bool	empty(void) const
+		{
+			return (size() == 0);
+		}
+
+		size_type	max_size(void) const
+		{
+			return (_segment_start(_max_segments - 1) + _segment_size(_max_segments - 1));
+		}
+
+		// allocates the segments of the first n slots, so that the
+		// push_back filling them do not allocate
+		void	reserve(size_type n)
+		{
+			if (n > max_size())
+				throw std::length_error("Tried to reserve in excess of maximum capacity");
+			if (n != 0)
+			{
+				for (size_type k = 0; k <= _segment_of(n - 1); k++)
+					_segment(k);
+			}
+		}
+
+		// element access
+
+		reference	operator[](size_type i)
+		{
+			return (_segment_at(_segment_of(i))[_offset_of(i)]);
+		}
+
+		const_reference	operator[](size_type i) const
+		{
+			return (_segment_at(_segment_of(i))[_offset_of(i)]);
+		}
+
+		reference	at(size_type i)
+		{
+			_check(i);
+			return ((*this)[i]);
+		}
+
+		const_reference	at(size_type i) const
+		{
+			_check(i);
+			return ((*this)[i]);
+		}
+
+		// modifiers
+
+		// returns the index of x, which the caller can read at once
+		size_type	push_back(const value_type& x)
+		{
+			size_type	i = __atomic_load_n(&_reserved, __ATOMIC_RELAXED);
+			pointer		segment;
+
+			// the segment is there before the index is taken, so that a
+			// failed allocation leaves no slot behind, and so that whoever
+			// sees the index taken also sees its segment
+			do
+			{
+				if (i == max_size())
+					throw std::length_error("Tried to allocate over max size");
+				segment = _segment(_segment_of(i));
+			}
+			while (!__atomic_compare_exchange_n(&_reserved, &i, i + 1, true,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+			try
+			{
+				_alloc.construct(segment + _offset_of(i), x);
+			}
+			catch (...)
+			{
+				_publish(i, _hole);
+				throw ;
+			}
+			_publish(i, _ready);
+			return (i);
+		}
+
+		// observers
+
+		allocator_type	get_allocator(void) const
+		{
+			return (allocator_type(_alloc));
+		}
+
+	private:
+		// the first segment holds 2^_first_log slots: the small vectors do
+		// not go through a handful of tiny segments
+		enum { _first_log = 3 };
+		enum { _max_segments = sizeof(size_type) * 8 - _first_log };
+		// the states of the slots
+		enum { _pending = 0, _ready = 1, _hole = 2 };
+
+		// slot i is slot i + 2^_first_log of a vector whose segment k
+		// starts at 2^(k + _first_log): its segment is given by its
+		// highest bit, its offset by the bits below
+		static size_type	_segment_of(size_type i)
+		{
+			return (sizeof(size_type) * 8 - 1 - __builtin_clzl(i + (1UL << _first_log)) - _first_log);
+		}
+
+		static size_type	_offset_of(size_type i)
+		{
+			return (i + (1UL << _first_log) - (1UL << (_segment_of(i) + _first_log)));
+		}
+
+		static size_type	_segment_start(size_type k)
+		{
+			return ((1UL << (k + _first_log)) - (1UL << _first_log));
+		}
+
+		static size_type	_segment_size(size_type k)
+		{
+			return (1UL << (k + _first_log));
+		}
+
+		// the states of a segment of n slots follow them, as bytes, in
+		// the same allocation
+		static size_type	_state_words(size_type n)
+		{
+			return ((n + sizeof(value_type) - 1) / sizeof(value_type));
+		}
+
+		char*	_states(size_type k) const
+		{
+			return (reinterpret_cast<char*>(__builtin_addressof(*(_segment_at(k) + _segment_size(k)))));
+		}
+
+		pointer	_segment_at(size_type k) const
+		{
+			return (__atomic_load_n(&_segments[k], __ATOMIC_ACQUIRE));
+		}
+
+		// segment k, allocated by the first thread that needs it: the
+		// others give their own allocation back
+		pointer	_segment(size_type k)
+		{
+			pointer		segment = _segment_at(k);
+			pointer		expected = pointer();
+			size_type	n = _segment_size(k);
+
+			if (segment != pointer())
+				return (segment);
+			segment = _alloc.allocate(n + _state_words(n));
+			std::memset(static_cast<void*>(__builtin_addressof(*(segment + n))),
+				_pending, _state_words(n) * sizeof(value_type));
+			if (__atomic_compare_exchange_n(&_segments[k], &expected, segment, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				return (segment);
+			_alloc.deallocate(segment, n + _state_words(n));
+			return (expected);
+		}
+
+		char	_state(size_type i) const
+		{
+			return (__atomic_load_n(_states(_segment_of(i)) + _offset_of(i), __ATOMIC_SEQ_CST));
+		}
+
+		// moves size over slot i, just done, and the done slots after it.
+		// a slot only gets a state when size had not reached it: the
+		// thread that brings size there then sees it done, as whichever of
+		// the two goes last sees the other. the slots below size are
+		// constructed unless they are holes
+		void	_publish(size_type i, char state)
+		{
+			size_type	n = i;
+
+			if (state != _ready || !__atomic_compare_exchange_n(&_size, &n, i + 1, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			{
+				__atomic_store_n(_states(_segment_of(i)) + _offset_of(i), state, __ATOMIC_SEQ_CST);
+				n = i;
+				if (!__atomic_compare_exchange_n(&_size, &n, i + 1, false,
+					__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+					return ;
+			}
+			while (++i < __atomic_load_n(&_reserved, __ATOMIC_SEQ_CST) && _state(i) != _pending)
+			{
+				n = i;
+				if (!__atomic_compare_exchange_n(&_size, &n, i + 1, false,
+					__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+					return ;
+			}
+		}
+
+		void	_check(size_type i) const
+		{
+			if (i >= size() || _state(i) == _hole)
+				throw std::out_of_range("Subscript out of range");
+		}
+
+		// shared between threads: not copyable
+		concurrent_vector(const concurrent_vector&);
+		concurrent_vector&	operator=(const concurrent_vector&);
+
+		size_type			_reserved;
+		size_type			_size;
+		pointer				_segments[_max_segments];
+		allocator_type		_alloc;
+};
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include "bench.hpp"
+
+// keeps the optimizer from discarding pops whose result is unused
+static size_t	g_sink;
+
+// one thread of bench_push_pop: rounds of batch pushes then batch pops,
+// one element at a time or as one bulk operation each
+template <typename Stack>
+struct bench_push_pop_task
+{
+	Stack*	stack;
+	size_t	rounds;
+	size_t	batch;
+	bool	bulk;
+	size_t	sum;
+
+	void	operator()(void)
+	{
+		std::vector<size_t>	values(batch);
+
+		for (size_t i = 0; i < batch; i++)
+			values[i] = i;
+		for (size_t r = 0; r < rounds; r++)
+		{
+			if (bulk)
+			{
+				stack->push_bulk(&values[0], &values[0] + batch);
+				stack->pop_bulk(&values[0], batch);
+			}
+			else
+			{
+				for (size_t i = 0; i < batch; i++)
+					stack->push(values[i]);
+				for (size_t i = 0; i < batch; i++)
+					stack->pop(values[i]);
+			}
+			sum += values[0];
+		}
+	}
+};
+
+// pushes and pops shared by threads threads, per element moved
+template <typename Stack>
+static void	bench_push_pop(const char* ns, size_t threads, size_t batch, bool bulk,
+	size_t elements)
+{
+	typedef bench_push_pop_task<Stack>	task_type;
+
+	Stack					stack;
+	std::vector<task_type>	tasks;
+	std::ostringstream		name;
+	double					start;
+
+	for (size_t i = 0; i < threads; i++)
+	{
+		task_type	t = { &stack, elements / batch, batch, bulk, 0 };
+
+		tasks.push_back(t);
+	}
+	start = bench_now();
+	ft::run_parallel(&tasks[0], threads);
+	name << (bulk ? "bulk " : "push/pop ") << batch << " x" << threads;
+	bench_report(name.str().c_str(), ns, batch, (bench_now() - start) / (elements * threads));
+	for (size_t i = 0; i < threads; i++)
+		g_sink += tasks[i].sum;
+}
+
+void	stack_bench(void)
+{
+	// push then pop, per element of all threads
+	for (size_t threads = 1; threads <= 8; threads *= 2)
+	{
+		bench_push_pop<ft::concurrent_stack<size_t> >("lf", threads, 1, false, 1000000);
+		bench_push_pop<bench_locked_stack>("mutex", threads, 1, false, 1000000);
+		for (size_t batch = 8; batch <= 64; batch *= 8)
+		{
+			bench_push_pop<ft::concurrent_stack<size_t> >("lf", threads, batch, false, 1000000);
+			bench_push_pop<ft::concurrent_stack<size_t> >("lf", threads, batch, true, 1000000);
+			bench_push_pop<bench_locked_stack>("mutex", threads, batch, true, 1000000);
+		}
+	}
+
+	if (g_sink == 42)
+		std::cout << std::endl;
+}
@@ -0,0 +1,81 @@
+#include "tests.hpp"
+
+void	stack_test(void)
+{
+	std::ofstream	outfile(STACK_FILENAME);
+
+	if (!outfile)
+	{
+		std::cerr << "failed to create stack test file" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Concurrent stack, from a single thread
+	{
+		typedef NS::CONCURRENT_STACK<std::string>	stack_type;
+
+		stack_type					stack;
+		std::vector<std::string>	bulk;
+		std::string					popped[8];
+		std::string					value = "none";
+		size_t						k;
+
+		outfile << stack.empty() << " " << stack_pop(stack, value) << " " << value << std::endl;
+		stack.push("a");
+		stack.push("b");
+		stack.push("c");
+		for (size_t i = 0; i < 5; i++)
+			bulk.push_back(std::string(i + 1, 'x'));
+		// the last one ends on top, as if pushed one by one
+		stack_push_bulk(stack, bulk.begin(), bulk.end());
+		stack_push_bulk(stack, bulk.begin(), bulk.begin());
+		outfile << stack.empty() << " " << stack_pop(stack, value) << " " << value << std::endl;
+		k = stack_pop_bulk(stack, popped, 3);
+		outfile << k;
+		for (size_t i = 0; i < k; i++)
+			outfile << " " << popped[i];
+		outfile << std::endl;
+		outfile << stack_pop_bulk(stack, popped, 0) << " " << stack_pop(stack, value)
+			<< " " << value << std::endl;
+		// fewer left than asked for
+		k = stack_pop_bulk(stack, popped, 8);
+		outfile << k;
+		for (size_t i = 0; i < k; i++)
+			outfile << " " << popped[i];
+		outfile << std::endl;
+		outfile << stack.empty() << " " << stack_pop(stack, value) << " " << value << " "
+			<< stack_pop_bulk(stack, popped, 8) << std::endl;
+		stack.push("again");
+		outfile << stack_pop(stack, value) << " " << value << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// Concurrent stack, from several threads: every value pushed is popped
+	// once, by one task or another
+	{
+		typedef NS::CONCURRENT_STACK<int>	stack_type;
+
+		stack_type				stack;
+		stack_task<stack_type>	tasks[6];
+		long					sum = 0;
+		size_t					missed = 0;
+		int						value;
+
+		for (int i = 0; i < 6; i++)
+		{
+			tasks[i]._stack = &stack;
+			tasks[i]._id = i;
+			tasks[i]._rounds = 2000;
+			tasks[i]._bulk = (i % 2 != 0);
+		}
+		run_tasks(tasks, 6);
+		for (int i = 0; i < 6; i++)
+		{
+			sum += tasks[i]._sum;
+			missed += tasks[i]._missed;
+		}
+		outfile << sum << " " << missed << " " << stack.empty() << " "
+			<< stack_pop(stack, value) << std::endl;
+	}
+}
@@ -2,26 +2,64 @@
 #define TESTS_HPP
 
 #include "srcs/map/map.hpp"
+#include "srcs/map/ranked_map.hpp"
+#include "srcs/map/aggregate_map.hpp"
+#include "srcs/map/persistent_map.hpp"
+#include "srcs/map/concurrent_map.hpp"
+#include "srcs/map/sharded_map.hpp"
+#include "srcs/map/rcu_map.hpp"
 #include "srcs/vector/vector.hpp"
+#include "srcs/vector/concurrent_vector.hpp"
 #include "srcs/stack/stack.hpp"
+#include "srcs/stack/concurrent_stack.hpp"
+#include "srcs/pool_allocator.hpp"
+#include "srcs/parallel.hpp"
 
 #include <map>
 #include <vector>
 #include <stack>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <iterator>
+#include <stdexcept>
 
 #ifdef FT
 	#define NS ft
 	#define MAP_FILENAME "ft_map_test.txt"
 	#define VEC_FILENAME "ft_vec_test.txt"
 	#define STACK_FILENAME "ft_stack_test.txt"
+	// ft::map looks up borrowed keys as they are
+	#define LOOKUP_KEY(x) (x)
+	#define RANKED_MAP ranked_map
+	#define AGGREGATE_MAP aggregate_map
+	#define PERSISTENT_MAP persistent_map
+	#define CONCURRENT_MAP concurrent_map
+	#define SHARDED_MAP sharded_map
+	#define RCU_MAP rcu_map
+	#define CONCURRENT_STACK concurrent_stack
+	#define CONCURRENT_VECTOR concurrent_vector
 #endif
 #ifdef STD
 	#define NS std
 	#define MAP_FILENAME "std_map_test.txt"
 	#define VEC_FILENAME "std_vec_test.txt"
 	#define STACK_FILENAME "std_stack_test.txt"
+	// the c++98 std::map only looks up key_type
+	#define LOOKUP_KEY(x) (std::string(x))
+	// order statistics are walked with the iterators of a plain map
+	#define RANKED_MAP map
+	// and range sums are computed by iterating the range
+	#define AGGREGATE_MAP map
+	// and snapshots are plain copies
+	#define PERSISTENT_MAP map
+	// and a map shared between threads is used from one
+	#define CONCURRENT_MAP map
+	#define SHARDED_MAP map
+	#define RCU_MAP map
+	// and so are a stack and a vector
+	#define CONCURRENT_STACK stack
+	#define CONCURRENT_VECTOR vector
 #endif
 
 #define PRINT_NODE(f, x) ((f) << (x)->first << " : " << (x)->second << std::endl)
@@ -32,6 +70,90 @@ void	stack_test(void);
 
 // test helper functions
 
+// key type that can only be built from a value
+class explicit_key {
+
+	public:
+		explicit explicit_key(size_t n) : _n(n) { }
+
+		bool	operator<(const explicit_key& other) const
+		{
+			return (_n < other._n);
+		}
+
+		size_t	get(void) const
+		{
+			return (_n);
+		}
+
+	private:
+		size_t	_n;
+};
+
+inline std::ostream&	operator<<(std::ostream& o, const explicit_key& key)
+{
+	return (o << key.get());
+}
+
+// transparent comparator: compares strings with c strings directly
+struct string_less {
+
+	typedef void	is_transparent;
+
+	bool	operator()(const std::string& x, const std::string& y) const
+	{
+		return (x < y);
+	}
+
+	bool	operator()(const std::string& x, const char* y) const
+	{
+		return (x.compare(y) < 0);
+	}
+
+	bool	operator()(const char* x, const std::string& y) const
+	{
+		return (y.compare(x) > 0);
+	}
+};
+
+// comparator with a state: the maps have to keep the one they were given
+struct directed_less {
+
+	directed_less(bool descending = false) : _descending(descending) { }
+
+	bool	operator()(int x, int y) const
+	{
+		return (_descending ? y < x : x < y);
+	}
+
+	bool	_descending;
+};
+
+// comparator that throws once a given number of comparisons were made,
+// from any number of threads
+struct throwing_less {
+
+	bool	operator()(size_t x, size_t y) const
+	{
+		size_t	n = __atomic_load_n(&budget(), __ATOMIC_RELAXED);
+
+		while (n != 0 && !__atomic_compare_exchange_n(&budget(), &n, n - 1, false,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			;
+		if (n == 1)
+			throw std::runtime_error("throwing_less");
+		return (x < y);
+	}
+
+	// the comparison that brings budget to 0 throws, 0 never does
+	static size_t&	budget(void)
+	{
+		static size_t	n = 0;
+
+		return (n);
+	}
+};
+
 template <typename Map>
 std::ofstream&	print_map(std::ofstream& f, const Map& map)
 {
@@ -52,6 +174,900 @@ void	fill_map(Map& map, size_t n)
 		map.insert(NS::make_pair(i, i * i));
 }
 
+// value whose copies throw once a given number of them were made,
+// and which counts its live instances: a container that leaks after
+// a throwing copy leaves some of them alive
+class throwing_value {
+
+	public:
+		throwing_value(size_t n = 0) : _n(n)
+		{
+			live()++;
+		}
+
+		throwing_value(const throwing_value& other) : _n(other._n)
+		{
+			if (budget() != 0 && --budget() == 0)
+				throw std::runtime_error("throwing_value copy");
+			live()++;
+		}
+
+		~throwing_value()
+		{
+			live()--;
+		}
+
+		throwing_value&	operator=(const throwing_value& other)
+		{
+			_n = other._n;
+			return (*this);
+		}
+
+		size_t	get(void) const
+		{
+			return (_n);
+		}
+
+		// the copy that brings budget to 0 throws, 0 never does
+		static size_t&	budget(void)
+		{
+			static size_t	n = 0;
+
+			return (n);
+		}
+
+		static size_t&	live(void)
+		{
+			static size_t	n = 0;
+
+			return (n);
+		}
+
+	private:
+		size_t	_n;
+};
+
+// allocator that counts the allocations made through all its copies
+template <typename T>
+class counting_allocator : public std::allocator<T> {
+
+	public:
+		typedef typename std::allocator<T>::pointer		pointer;
+		typedef typename std::allocator<T>::size_type	size_type;
+
+		template <typename U>
+		struct rebind {
+			typedef counting_allocator<U>	other;
+		};
+
+		counting_allocator(void) { }
+		counting_allocator(const counting_allocator& from) : std::allocator<T>(from) { }
+		template <typename U>
+		counting_allocator(const counting_allocator<U>& from) : std::allocator<T>(from) { }
+
+		pointer	allocate(size_type n, const void* hint = 0)
+		{
+			allocations()++;
+			return (std::allocator<T>::allocate(n, hint));
+		}
+
+		static size_t&	allocations(void)
+		{
+			static size_t	n = 0;
+
+			return (n);
+		}
+};
+
+// adds n to the values it is called on, through sharded_map::update
+struct add_to {
+
+	add_to(long n) : _n(n) { }
+
+	void	operator()(long& value) const
+	{
+		value += _n;
+	}
+
+	long	_n;
+};
+
+// batch of writes, published at once by rcu_map::update
+struct batch_update {
+
+	batch_update(int first, int n) : _first(first), _n(n) { }
+
+	template <typename Map>
+	void	operator()(Map& map) const
+	{
+		for (int i = 0; i < _n; i++)
+			map.insert(NS::make_pair(_first + i, static_cast<long>(i)));
+		map.erase(_first - 1);
+	}
+
+	int	_first;
+	int	_n;
+};
+
+// the c++98 std::map lacks try_emplace, insert_or_assign, emplace, node handles,
+// split, join, order statistics, find_many, aggregates, from_unsorted,
+// set algebra, snapshots, the lookups by copy of concurrent_map, the
+// views of sharded_map and the versions of rcu_map:
+// for std they are emulated with insert, with the same results
+
+#ifdef FT
+// the tasks of the tests shared between threads run at once for ft, and
+// one after the other for std
+template <typename Task>
+void	run_tasks(Task* tasks, size_t n)
+{
+	ft::run_parallel(tasks, n);
+}
+
+template <typename Map, typename M>
+NS::pair<typename Map::iterator, bool>
+map_try_emplace(Map& map, const typename Map::key_type& k, const M& obj)
+{
+	return (map.try_emplace(k, obj));
+}
+
+template <typename Map, typename M>
+NS::pair<typename Map::iterator, bool>
+map_insert_or_assign(Map& map, const typename Map::key_type& k, const M& obj)
+{
+	return (map.insert_or_assign(k, obj));
+}
+
+template <typename Map, typename K, typename M>
+typename Map::iterator
+map_emplace_hint(Map& map, typename Map::iterator hint, const K& k, const M& obj)
+{
+	return (map.emplace_hint(hint, k, obj));
+}
+
+// moves the node of key from src to dst, where it may be given a new key
+template <typename Map>
+bool	map_move_node(Map& dst, Map& src, const typename Map::key_type& key,
+	const typename Map::key_type& new_key)
+{
+	typename Map::node_type				nh = src.extract(key);
+	typename Map::insert_return_type	ret;
+
+	if (nh.empty())
+		return (false);
+	nh.key() = new_key;
+	ret = dst.insert(nh);
+	if (!ret.inserted)
+	{
+		ret.node.key() = key;
+		src.insert(ret.node);
+	}
+	return (ret.inserted);
+}
+
+// same, with the end of dst as a hint and without a new key
+template <typename Map>
+bool	map_move_node_hint(Map& dst, Map& src, const typename Map::key_type& key)
+{
+	typename Map::node_type	nh = src.extract(key);
+
+	if (nh.empty())
+		return (false);
+	dst.insert(dst.end(), nh);
+	if (nh.empty())
+		return (true);
+	src.insert(nh);
+	return (false);
+}
+
+template <typename Map>
+void	map_merge(Map& dst, Map& src)
+{
+	dst.merge(src);
+}
+
+template <typename Map>
+Map	map_split(Map& map, const typename Map::key_type& key)
+{
+	return (map.split(key));
+}
+
+template <typename Map>
+void	map_join(Map& dst, Map& src)
+{
+	dst.join(src);
+}
+
+template <typename Map>
+typename Map::const_iterator	map_nth(const Map& map, size_t k)
+{
+	return (map.nth(k));
+}
+
+template <typename Map>
+size_t	map_rank(const Map& map, const typename Map::key_type& key)
+{
+	return (map.rank(key));
+}
+
+template <typename Map>
+ptrdiff_t	map_distance(const Map& map, typename Map::const_iterator first,
+	typename Map::const_iterator last)
+{
+	return (map.distance(first, last));
+}
+
+template <typename Map, typename ForwardIterator, typename OutputIterator>
+OutputIterator	map_find_many(const Map& map, ForwardIterator first, ForwardIterator last,
+	OutputIterator out)
+{
+	return (map.find_many(first, last, out));
+}
+
+template <typename Map>
+typename Map::mapped_type	map_aggregate(const Map& map, const typename Map::key_type& lo,
+	const typename Map::key_type& hi)
+{
+	return (map.aggregate(lo, hi));
+}
+
+template <typename Key, typename T, typename Compare>
+struct aggregate_map_type {
+	typedef ft::aggregate_map<Key, T, ft::sum_monoid<T>, Compare>	type;
+};
+
+template <typename Map>
+void	map_refresh(Map& map, typename Map::iterator position)
+{
+	map.refresh(position);
+}
+
+template <typename Map, typename InputIterator>
+Map	map_from_unsorted(InputIterator first, InputIterator last, size_t threads)
+{
+	return (Map::from_unsorted(ft::parallel_execution(threads), first, last));
+}
+
+template <typename Map>
+void	map_unite(Map& map, Map& other, size_t threads)
+{
+	map.unite(ft::parallel_execution(threads), other);
+}
+
+template <typename Map>
+void	map_intersect(Map& map, const Map& other, size_t threads)
+{
+	map.intersect(ft::parallel_execution(threads), other);
+}
+
+template <typename Map>
+void	map_subtract(Map& map, const Map& other, size_t threads)
+{
+	map.subtract(ft::parallel_execution(threads), other);
+}
+
+template <typename Map>
+Map	map_snapshot(const Map& map)
+{
+	return (map.snapshot());
+}
+
+template <typename Map>
+bool	map_find_copy(const Map& map, const typename Map::key_type& k,
+	typename Map::mapped_type& value)
+{
+	return (map.find(k, value));
+}
+
+template <typename Map>
+void	map_store(Map& map, const typename Map::key_type& k, const typename Map::mapped_type& obj)
+{
+	map.insert_or_assign(k, obj);
+}
+
+template <typename Map, typename Function>
+void	map_apply(Map& map, const typename Map::key_type& k, Function f)
+{
+	map.update(k, f);
+}
+
+template <typename Map>
+typename Map::map_type	map_copy(const Map& map)
+{
+	return (map.copy());
+}
+
+template <typename Map>
+void	print_ordered(std::ofstream& f, Map& map)
+{
+	typename Map::ordered_view	view(map);
+
+	for (typename Map::ordered_view::iterator it = view.begin(); it != view.end(); ++it)
+		PRINT_NODE(f, it);
+}
+
+// walks the shards one by one: the number of keys in order and in their
+// shard, which is all of them
+template <typename Map>
+size_t	count_sharded(Map& map)
+{
+	size_t	n = 0;
+
+	for (size_t i = 0; i < map.shard_count(); i++)
+	{
+		typename Map::shard_view	view(map, i);
+
+		for (typename Map::shard_view::iterator it = view.begin(); it != view.end(); ++it)
+		{
+			typename Map::shard_view::iterator	next = it;
+
+			++next;
+			n += (map.shard_of(it->first) == i
+				&& (next == view.end() || map.key_comp()(it->first, next->first)));
+		}
+	}
+	return (n);
+}
+
+template <typename Map>
+struct published_type {
+	typedef typename Map::snapshot_type	type;
+};
+
+template <typename Map>
+typename Map::snapshot_type	map_published(const Map& map)
+{
+	return (map.snapshot());
+}
+
+template <typename Map, typename Function>
+void	map_update(Map& map, Function f)
+{
+	map.update(f);
+}
+
+// the bulk operations and the pops by copy of concurrent_stack
+template <typename Stack, typename InputIterator>
+void	stack_push_bulk(Stack& stack, InputIterator first, InputIterator last)
+{
+	stack.push_bulk(first, last);
+}
+
+template <typename Stack>
+bool	stack_pop(Stack& stack, typename Stack::value_type& value)
+{
+	return (stack.pop(value));
+}
+
+template <typename Stack, typename OutputIterator>
+size_t	stack_pop_bulk(Stack& stack, OutputIterator out, size_t n)
+{
+	return (stack.pop_bulk(out, n));
+}
+
+// the index push_back of concurrent_vector returns
+template <typename Vec>
+size_t	vec_push(Vec& vec, const typename Vec::value_type& x)
+{
+	return (vec.push_back(x));
+}
+#endif
+#ifdef STD
+template <typename Task>
+void	run_tasks(Task* tasks, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		tasks[i]();
+}
+
+template <typename Map, typename M>
+NS::pair<typename Map::iterator, bool>
+map_try_emplace(Map& map, const typename Map::key_type& k, const M& obj)
+{
+	return (map.insert(typename Map::value_type(k, obj)));
+}
+
+template <typename Map, typename M>
+NS::pair<typename Map::iterator, bool>
+map_insert_or_assign(Map& map, const typename Map::key_type& k, const M& obj)
+{
+	NS::pair<typename Map::iterator, bool>	ret = map.insert(typename Map::value_type(k, obj));
+
+	if (!ret.second)
+		ret.first->second = obj;
+	return (ret);
+}
+
+template <typename Map, typename K, typename M>
+typename Map::iterator
+map_emplace_hint(Map& map, typename Map::iterator hint, const K& k, const M& obj)
+{
+	return (map.insert(hint, typename Map::value_type(k, obj)));
+}
+
+template <typename Map>
+bool	map_move_node(Map& dst, Map& src, const typename Map::key_type& key,
+	const typename Map::key_type& new_key)
+{
+	typename Map::iterator	it = src.find(key);
+
+	if (it == src.end() || !dst.insert(typename Map::value_type(new_key, it->second)).second)
+		return (false);
+	src.erase(it);
+	return (true);
+}
+
+template <typename Map>
+bool	map_move_node_hint(Map& dst, Map& src, const typename Map::key_type& key)
+{
+	typename Map::iterator	it = src.find(key);
+
+	if (it == src.end() || dst.count(key) != 0)
+		return (false);
+	dst.insert(dst.end(), *it);
+	src.erase(it);
+	return (true);
+}
+
+template <typename Map>
+void	map_merge(Map& dst, Map& src)
+{
+	typename Map::iterator	it = src.begin();
+
+	while (it != src.end())
+	{
+		if (dst.insert(*it).second)
+			src.erase(it++);
+		else
+			++it;
+	}
+}
+
+template <typename Map>
+Map	map_split(Map& map, const typename Map::key_type& key)
+{
+	Map	upper(map.lower_bound(key), map.end());
+
+	map.erase(map.lower_bound(key), map.end());
+	return (upper);
+}
+
+template <typename Map>
+void	map_join(Map& dst, Map& src)
+{
+	map_merge(dst, src);
+}
+
+template <typename Map>
+typename Map::const_iterator	map_nth(const Map& map, size_t k)
+{
+	typename Map::const_iterator	it = map.begin();
+
+	if (k >= map.size())
+		return (map.end());
+	std::advance(it, k);
+	return (it);
+}
+
+template <typename Map>
+size_t	map_rank(const Map& map, const typename Map::key_type& key)
+{
+	return (std::distance(map.begin(), map.lower_bound(key)));
+}
+
+template <typename Map>
+ptrdiff_t	map_distance(const Map&, typename Map::const_iterator first,
+	typename Map::const_iterator last)
+{
+	return (std::distance(first, last));
+}
+
+template <typename Map, typename ForwardIterator, typename OutputIterator>
+OutputIterator	map_find_many(const Map& map, ForwardIterator first, ForwardIterator last,
+	OutputIterator out)
+{
+	for (; first != last; ++first)
+		*out++ = map.find(*first);
+	return (out);
+}
+
+template <typename Map>
+typename Map::mapped_type	map_aggregate(const Map& map, const typename Map::key_type& lo,
+	const typename Map::key_type& hi)
+{
+	typename Map::mapped_type		ret = typename Map::mapped_type();
+	typename Map::const_iterator	it = map.lower_bound(lo);
+
+	if (!map.key_comp()(lo, hi))
+		return (ret);
+	for (; it != map.lower_bound(hi); ++it)
+		ret += it->second;
+	return (ret);
+}
+
+template <typename Key, typename T, typename Compare>
+struct aggregate_map_type {
+	typedef std::map<Key, T, Compare>	type;
+};
+
+template <typename Map>
+void	map_refresh(Map&, typename Map::iterator)
+{ }
+
+template <typename Map, typename InputIterator>
+Map	map_from_unsorted(InputIterator first, InputIterator last, size_t)
+{
+	return (Map(first, last));
+}
+
+template <typename Map>
+void	map_unite(Map& map, Map& other, size_t)
+{
+	map.insert(other.begin(), other.end());
+	other.clear();
+}
+
+template <typename Map>
+void	map_intersect(Map& map, const Map& other, size_t)
+{
+	typename Map::iterator	it = map.begin();
+
+	while (it != map.end())
+	{
+		if (other.count(it->first) == 0)
+			map.erase(it++);
+		else
+			++it;
+	}
+}
+
+template <typename Map>
+void	map_subtract(Map& map, const Map& other, size_t)
+{
+	for (typename Map::const_iterator it = other.begin(); it != other.end(); ++it)
+		map.erase(it->first);
+}
+
+template <typename Map>
+Map	map_snapshot(const Map& map)
+{
+	return (Map(map));
+}
+
+template <typename Map>
+bool	map_find_copy(const Map& map, const typename Map::key_type& k,
+	typename Map::mapped_type& value)
+{
+	typename Map::const_iterator	it = map.find(k);
+
+	if (it == map.end())
+		return (false);
+	value = it->second;
+	return (true);
+}
+
+template <typename Map>
+void	map_store(Map& map, const typename Map::key_type& k, const typename Map::mapped_type& obj)
+{
+	map[k] = obj;
+}
+
+template <typename Map, typename Function>
+void	map_apply(Map& map, const typename Map::key_type& k, Function f)
+{
+	f(map[k]);
+}
+
+template <typename Map>
+Map	map_copy(const Map& map)
+{
+	return (map);
+}
+
+template <typename Map>
+void	print_ordered(std::ofstream& f, Map& map)
+{
+	print_map(f, map);
+}
+
+template <typename Map>
+size_t	count_sharded(Map& map)
+{
+	return (map.size());
+}
+
+template <typename Map>
+struct published_type {
+	typedef Map	type;
+};
+
+template <typename Map>
+Map	map_published(const Map& map)
+{
+	return (map);
+}
+
+template <typename Map, typename Function>
+void	map_update(Map& map, Function f)
+{
+	f(map);
+}
+
+template <typename Stack, typename InputIterator>
+void	stack_push_bulk(Stack& stack, InputIterator first, InputIterator last)
+{
+	for (; first != last; ++first)
+		stack.push(*first);
+}
+
+template <typename Stack>
+bool	stack_pop(Stack& stack, typename Stack::value_type& value)
+{
+	if (stack.empty())
+		return (false);
+	value = stack.top();
+	stack.pop();
+	return (true);
+}
+
+template <typename Stack, typename OutputIterator>
+size_t	stack_pop_bulk(Stack& stack, OutputIterator out, size_t n)
+{
+	size_t	k = 0;
+
+	for (; k < n && stack_pop(stack, *out); k++)
+		++out;
+	return (k);
+}
+
+template <typename Vec>
+size_t	vec_push(Vec& vec, const typename Vec::value_type& x)
+{
+	vec.push_back(x);
+	return (vec.size() - 1);
+}
+#endif
+
+// copies an allocator shared by several threads, which only read it
+template <typename Allocator>
+struct allocator_copy_task {
+
+	allocator_copy_task(void) : _from(NULL) { }
+
+	void	operator()(void)
+	{
+		_copy = *_from;
+	}
+
+	const Allocator*	_from;
+	Allocator			_copy;
+};
+
+// share of the work on a map used by several threads: a writer stores
+// 2 * k for its keys, those equal to id modulo writers, then erases one
+// in three of them. a reader looks up all the keys until the writers are
+// done, and counts the values it found that no writer stored
+template <typename Map>
+struct map_task {
+
+	map_task(void) : _map(NULL), _done(NULL), _id(0), _writers(0), _keys(0),
+		_reader(false), _bad(0) { }
+
+	void	operator()(void)
+	{
+		long	value;
+
+		if (_reader)
+		{
+			for (int pass = 0; pass < 2 || __atomic_load_n(_done, __ATOMIC_ACQUIRE) < _writers;
+				pass++)
+			{
+				for (int k = 0; k < _keys; k++)
+					_bad += (map_find_copy(*_map, k, value) && value != 2L * k);
+			}
+			return ;
+		}
+		// every key is stored twice: the second store assigns the value of
+		// a key the readers may be in
+		for (int k = _id; k < _keys; k += _writers)
+		{
+			map_store(*_map, k, 2L * k);
+			map_store(*_map, k, 2L * k);
+		}
+		for (int k = _id; k < _keys; k += _writers)
+		{
+			if (k % 3 == 0)
+				_map->erase(k);
+		}
+		__atomic_add_fetch(_done, 1, __ATOMIC_RELEASE);
+	}
+
+	Map*	_map;
+	// the number of writers done, shared by the tasks
+	int*	_done;
+	int		_id;
+	int		_writers;
+	int		_keys;
+	bool	_reader;
+	size_t	_bad;
+};
+
+// write of an rcu_map test: every key gets the number of the round
+struct round_update {
+
+	round_update(int round, int keys) : _round(round), _keys(keys) { }
+
+	template <typename Map>
+	void	operator()(Map& map) const
+	{
+		for (int k = 0; k < _keys; k++)
+			map_store(map, k, static_cast<long>(_round));
+	}
+
+	int	_round;
+	int	_keys;
+};
+
+// share of the work on an rcu_map used by several threads: the writer
+// publishes its rounds one after the other, the readers check that each
+// version they get holds a whole round, no older than the last one seen,
+// until the writer is done. they count the versions that do not
+template <typename Map>
+struct rcu_task {
+
+	rcu_task(void) : _map(NULL), _done(NULL), _rounds(0), _keys(0), _reader(false), _bad(0) { }
+
+	void	operator()(void)
+	{
+		typedef typename published_type<Map>::type	version_type;
+
+		long	last = -1;
+		long	round;
+
+		if (!_reader)
+		{
+			for (int r = 0; r < _rounds; r++)
+				map_update(*_map, round_update(r, _keys));
+			__atomic_store_n(_done, 1, __ATOMIC_RELEASE);
+			return ;
+		}
+		for (int pass = 0; pass < 2 || __atomic_load_n(_done, __ATOMIC_ACQUIRE) == 0; pass++)
+		{
+			const version_type	version = map_published(*_map);
+
+			round = version.empty() ? -1 : version.begin()->second;
+			_bad += (round < last
+				|| (!version.empty() && version.size() != static_cast<size_t>(_keys)));
+			for (typename version_type::const_iterator it = version.begin();
+				it != version.end(); ++it)
+				_bad += (it->second != round);
+			last = round;
+		}
+	}
+
+	Map*	_map;
+	// set once the writer is done
+	int*	_done;
+	int		_rounds;
+	int		_keys;
+	bool	_reader;
+	size_t	_bad;
+};
+
+// share of the work on a map used by several threads, as counters:
+// rounds that add 1 to the values of all the keys, in place
+template <typename Map>
+struct counter_task {
+
+	counter_task(void) : _map(NULL), _rounds(0), _keys(0) { }
+
+	void	operator()(void)
+	{
+		for (int round = 0; round < _rounds; round++)
+		{
+			for (int k = 0; k < _keys; k++)
+				map_apply(*_map, k, add_to(1));
+		}
+	}
+
+	Map*	_map;
+	int		_rounds;
+	int		_keys;
+};
+
+// share of the work on a stack used by several threads: rounds that
+// push a batch of the task's own values, one by one or as one bulk push,
+// then pop as many values, whoever pushed them. the task adds up what it
+// popped, and counts the pops that found the stack empty, which cannot
+// happen as the task pops no more than it pushed
+template <typename Stack>
+struct stack_task {
+
+	stack_task(void) : _stack(NULL), _id(0), _rounds(0), _bulk(false), _sum(0), _missed(0) { }
+
+	void	operator()(void)
+	{
+		int		values[_batch];
+		size_t	k;
+
+		for (int r = 0; r < _rounds; r++)
+		{
+			for (size_t i = 0; i < _batch; i++)
+				values[i] = (_id * _rounds + r) * _batch + i;
+			if (_bulk)
+			{
+				stack_push_bulk(*_stack, values, values + _batch);
+				k = stack_pop_bulk(*_stack, values, _batch);
+			}
+			else
+			{
+				for (size_t i = 0; i < _batch; i++)
+					_stack->push(values[i]);
+				for (k = 0; k < _batch && stack_pop(*_stack, values[k]); k++)
+					;
+			}
+			_missed += _batch - k;
+			for (size_t i = 0; i < k; i++)
+				_sum += values[i];
+		}
+	}
+
+	static const size_t	_batch = 16;
+
+	Stack*	_stack;
+	int		_id;
+	int		_rounds;
+	bool	_bulk;
+	long	_sum;
+	size_t	_missed;
+};
+
+// share of the work on a vector used by several threads: a producer
+// appends id * n to id * n + n - 1 and reads each back at the index it
+// got, which size() may not have reached yet. a reader reads every index
+// below size() as size() moves on, until the producers are done. both
+// count the values that are not what they should be
+template <typename Vec>
+struct vec_task {
+
+	vec_task(void) : _vec(NULL), _done(NULL), _id(0), _producers(0), _n(0),
+		_reader(false), _bad(0) { }
+
+	void	operator()(void)
+	{
+		size_t	seen = 0;
+		size_t	size;
+		long	value;
+
+		if (_reader)
+		{
+			for (int pass = 0; pass < 2 || __atomic_load_n(_done, __ATOMIC_ACQUIRE) < _producers;
+				pass++)
+			{
+				size = _vec->size();
+				for (; seen < size; seen++)
+					_bad += (_vec->at(seen) < 0 || _vec->at(seen) >= _producers * _n);
+			}
+			return ;
+		}
+		for (long j = 0; j < _n; j++)
+		{
+			value = _id * _n + j;
+			_bad += ((*_vec)[vec_push(*_vec, value)] != value);
+		}
+		__atomic_add_fetch(_done, 1, __ATOMIC_RELEASE);
+	}
+
+	Vec*	_vec;
+	// the number of producers done, shared by the tasks
+	int*	_done;
+	long	_id;
+	int		_producers;
+	long	_n;
+	bool	_reader;
+	size_t	_bad;
+};
+
 template <typename Vec>
 std::ofstream&	print_vec(std::ofstream& f, const Vec& vec)
 {
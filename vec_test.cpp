@@ -0,0 +1,140 @@
+#include "tests.hpp"
+
+#include <algorithm>
+
+void	vec_test(void)
+{
+	std::ofstream	outfile(VEC_FILENAME);
+
+	if (!outfile)
+	{
+		std::cerr << "failed to create vector test file" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Concurrent vector, from a single thread
+	{
+		typedef NS::CONCURRENT_VECTOR<size_t>	vec_type;
+
+		vec_type	vec;
+		size_t		index;
+
+		outfile << vec.size() << " " << vec.empty() << std::endl;
+		// the segments hold 8, 16 then 32 slots: 7, 8, 23 and 24 are
+		// the last and first slots of two of them
+		for (size_t i = 0; i < 40; i++)
+		{
+			index = vec_push(vec, i * i);
+			if (index == 0 || index == 7 || index == 8 || index == 23 || index == 24
+				|| index == 39)
+				outfile << i << " " << index << " " << vec[index] << " " << vec.at(index)
+					<< std::endl;
+		}
+		outfile << vec.size() << " " << vec.empty() << std::endl;
+		for (size_t i = 0; i < vec.size(); i++)
+			outfile << vec[i] << " ";
+		outfile << std::endl;
+		try {
+			outfile << vec.at(40) << std::endl;
+		} catch (std::out_of_range& e) {
+			outfile << "at threw out_of_range" << std::endl;
+		}
+		for (size_t i = 40; i < 1000; i++)
+			vec_push(vec, i * i);
+		outfile << vec.size() << " " << vec[500] << " " << vec.at(999) << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// a copy that throws leaves a hole that at() will not read
+	{
+		typedef NS::CONCURRENT_VECTOR<throwing_value>	vec_type;
+
+		size_t	live = throwing_value::live();
+
+		{
+			vec_type	vec;
+			size_t		index;
+
+			for (size_t i = 0; i < 8; i++)
+				vec_push(vec, throwing_value(i));
+			// slot 8, the first of the second segment, is the hole
+			throwing_value::budget() = 1;
+			try {
+				vec_push(vec, throwing_value(8));
+			} catch (std::exception& e) {
+				outfile << "push_back threw exception" << std::endl;
+			}
+			try {
+				outfile << vec.at(8).get() << std::endl;
+			} catch (std::out_of_range& e) {
+				outfile << "at threw out_of_range" << std::endl;
+			}
+			// the slots around it can still be read
+			index = vec_push(vec, throwing_value(9));
+			outfile << vec.at(7).get() << " " << vec.at(index).get() << std::endl;
+		}
+		outfile << throwing_value::live() - live << std::endl;
+	}
+
+	outfile << std::endl;
+
+	// reserve
+	{
+		typedef NS::CONCURRENT_VECTOR<size_t, counting_allocator<size_t> >	vec_type;
+
+		vec_type	vec;
+		size_t		allocations;
+
+		vec.reserve(0);
+		outfile << vec.size() << std::endl;
+		vec.reserve(100);
+		// the pushes that fill the reserved slots do not allocate
+		allocations = counting_allocator<size_t>::allocations();
+		for (size_t i = 0; i < 100; i++)
+			vec_push(vec, i);
+		outfile << counting_allocator<size_t>::allocations() - allocations << " "
+			<< vec.size() << " " << vec.at(99) << std::endl;
+		vec.reserve(50);
+		outfile << vec.size() << " " << vec.at(50) << std::endl;
+		try {
+			vec.reserve(vec.max_size() + 1);
+		} catch (std::length_error& e) {
+			outfile << "reserve threw length_error" << std::endl;
+		}
+	}
+
+	outfile << std::endl;
+
+	// Concurrent vector, from several threads: readers index below size()
+	// while the producers append
+	{
+		typedef NS::CONCURRENT_VECTOR<long>	vec_type;
+
+		vec_type			vec;
+		vec_task<vec_type>	tasks[6];
+		std::vector<long>	values;
+		int					done = 0;
+		size_t				bad = 0;
+
+		// the producers come first: for std, the readers run once they are done
+		for (int i = 0; i < 6; i++)
+		{
+			tasks[i]._vec = &vec;
+			tasks[i]._done = &done;
+			tasks[i]._id = i;
+			tasks[i]._producers = 3;
+			tasks[i]._n = 5000;
+			tasks[i]._reader = (i >= 3);
+		}
+		run_tasks(tasks, 6);
+		for (int i = 0; i < 6; i++)
+			bad += tasks[i]._bad;
+		for (size_t i = 0; i < vec.size(); i++)
+			values.push_back(vec.at(i));
+		std::sort(values.begin(), values.end());
+		for (size_t i = 0; i < values.size(); i++)
+			bad += (values[i] != static_cast<long>(i));
+		outfile << vec.size() << " " << bad << std::endl;
+	}
+}
@@ -0,0 +1,88 @@
+#include "bench.hpp"
+
+// keeps the optimizer from discarding reads whose result is unused
+static size_t	g_sink;
+
+// one thread of bench_append: appends, or reads every element up to
+// the size it sees until the appenders are done
+template <typename Vector>
+struct bench_append_task
+{
+	Vector*	vector;
+	size_t	n;
+	size_t	total;
+	bool	reader;
+	size_t	sum;
+
+	void	operator()(void)
+	{
+		size_t	seen = 0;
+		size_t	size;
+
+		if (!reader)
+		{
+			for (size_t i = 0; i < n; i++)
+				sum += vector->push_back(i);
+			return ;
+		}
+		while (seen < total)
+		{
+			size = vector->size();
+			for (; seen < size; seen++)
+				sum += (*vector)[seen];
+		}
+	}
+};
+
+// threads threads appending n elements each, while readers more
+// threads read them, per element appended
+template <typename Vector>
+static void	bench_append(const char* ns, size_t threads, size_t readers, size_t n, bool reserve)
+{
+	typedef bench_append_task<Vector>	task_type;
+
+	Vector					vector;
+	std::vector<task_type>	tasks;
+	std::ostringstream		name;
+	double					start;
+
+	if (reserve)
+		vector.reserve(n * threads);
+	for (size_t i = 0; i < threads + readers; i++)
+	{
+		task_type	t = { &vector, n, n * threads, i >= threads, 0 };
+
+		tasks.push_back(t);
+	}
+	start = bench_now();
+	ft::run_parallel(&tasks[0], threads + readers);
+	name << (reserve ? "reserved " : "append ") << "x" << threads;
+	if (readers != 0)
+		name << " +" << readers << "r";
+	bench_report(name.str().c_str(), ns, n * threads, (bench_now() - start) / (n * threads));
+	for (size_t i = 0; i < threads + readers; i++)
+		g_sink += tasks[i].sum;
+}
+
+void	vector_bench(void)
+{
+	// appends, per element of all threads
+	for (size_t threads = 1; threads <= 8; threads *= 2)
+	{
+		for (size_t reserve = 0; reserve <= 1; reserve++)
+		{
+			bench_append<ft::concurrent_vector<size_t> >("lf", threads, 0, 1000000, reserve);
+			bench_append<bench_locked_vector>("mutex", threads, 0, 1000000, reserve);
+		}
+	}
+
+	// appends while a reader follows them
+	for (size_t threads = 1; threads <= 4; threads *= 2)
+	{
+		bench_append<ft::concurrent_vector<size_t> >("lf", threads, 1, 1000000, false);
+		bench_append<bench_locked_vector>("mutex", threads, 1, 1000000, false);
+	}
+
+	if (g_sink == 42)
+		std::cout << std::endl;
+}